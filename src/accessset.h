@@ -0,0 +1,163 @@
+#ifndef ACCESSSET_H
+#define ACCESSSET_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using namespace std;
+
+namespace Tm {
+
+class VariableBase;
+
+/**
+ * \brief Everything a transaction knows about one variable it accessed.
+ *
+ * A variable can be read, written, or read and then written; in the latter case the read buffer
+ * is taken over by the write and readBuffer is set back to nullptr.
+ */
+struct AccessEntry {
+	/// *raw* ptr of the variable class object; unique key of the entry
+	VariableBase * var;
+
+	/// *raw* ptr of local copy, nullptr unless the variable is in the read set
+	void * readBuffer;
+
+	/// ptr to ValueStorage<T>::WriteBuffer (shared ptr of local copy, or a word), nullptr unless the variable is in the write set
+	void * writeBuffer;
+
+	/// what ValueStorage<T>::hijack returned for the buffer hijacked from a committing lock owner (irrevocable transaction only)
+	void * hijackedBuffer;
+};
+
+/**
+ * \brief Read and write set of a transaction, a flat replacement for a pair of hash maps.
+ *
+ * Entries are kept densely in insertion order, so iterating over them is a linear scan.
+ * Small sets are searched linearly, too; once they grow beyond linearScanLimit an
+ * open-addressing index (linear probing, power-of-two sized) over the entries is built.
+ *
+ * clear() keeps all the memory, so a set that is reused by subsequent transactions stops
+ * allocating once it reached the size of the largest transaction.
+ *
+ * Entries are never erased during a transaction. Pointers to entries stay valid until the next insert().
+ */
+class AccessSet {
+public:
+	typedef vector<AccessEntry>::iterator iterator;
+
+	/// below this many entries, the index is not used at all
+	static const size_t linearScanLimit = 8;
+
+	/// \returns entry for var or nullptr if var has not been accessed yet
+	AccessEntry * find(VariableBase * var) {
+		if(index.empty()) {
+			for(auto & e : entries)
+				if(e.var == var)
+					return &e;
+			return nullptr;
+		}
+
+		for(size_t slot = home(var) ; ; slot = (slot+1) & mask) {
+			uint32_t i = index[slot];
+			if(i == 0)
+				return nullptr;
+			if(entries[i-1].var == var)
+				return &entries[i-1];
+		}
+	}
+
+	/// adds a blank entry for var; var must not be present in the set
+	AccessEntry & insert(VariableBase * var) {
+		assert(find(var) == nullptr);
+
+		entries.push_back(AccessEntry{var, nullptr, nullptr, nullptr});
+
+		if(!index.empty() || entries.size() > linearScanLimit) {
+			if(entries.size() * 2 > index.size())
+				rehash(entries.size() * 2);
+			else
+				place(entries.size()-1);
+		}
+
+		return entries.back();
+	}
+
+	/// prepares the set for n entries, so that inserting them won't allocate
+	void reserve(size_t n) {
+		entries.reserve(n);
+		if(n > linearScanLimit && n * 2 > index.size())
+			rehash(n * 2);
+	}
+
+	/// forgets all entries, but keeps the memory for future use
+	void clear() {
+		if(!index.empty()) {
+			// zeroing only used slots keeps clear() proportional to size, not to capacity
+			for(size_t i = 0 ; i < entries.size(); ++i) {
+				size_t slot = home(entries[i].var);
+				while(index[slot] != i+1)
+					slot = (slot+1) & mask;
+				index[slot] = 0;
+			}
+			// once the index exists it is kept, so lookups in small sets use it too - that's fine
+		}
+		entries.clear();
+	}
+
+	size_t size() const {return entries.size();}
+
+	bool empty() const {return entries.empty();}
+
+	iterator begin() {return entries.begin();}
+
+	iterator end() {return entries.end();}
+
+protected:
+	/// dense storage of the entries
+	vector<AccessEntry> entries;
+
+	/// open-addressing index; 0 means free slot, otherwise position in entries + 1
+	vector<uint32_t> index;
+
+	/// index.size() - 1
+	size_t mask = 0;
+
+	/// 64 - log2(index.size()), used by Fibonacci hashing
+	unsigned shift = 64;
+
+	size_t home(VariableBase * var) const {
+		return (uint64_t(reinterpret_cast<uintptr_t>(var)) * 0x9E3779B97F4A7C15ull) >> shift;
+	}
+
+	/// puts entries[i] in the index
+	void place(size_t i) {
+		size_t slot = home(entries[i].var);
+		while(index[slot] != 0)
+			slot = (slot+1) & mask;
+		index[slot] = i+1;
+	}
+
+	/// rebuilds the index so that it has at least minSlots slots
+	void rehash(size_t minSlots) {
+		size_t slots = 16;
+		unsigned bits = 4;
+		while(slots < minSlots) {
+			slots *= 2;
+			++bits;
+		}
+
+		index.assign(slots, 0);
+		mask = slots - 1;
+		shift = 64 - bits;
+
+		for(size_t i = 0 ; i < entries.size(); ++i)
+			place(i);
+	}
+};
+
+/*namespace TM end*/}
+
+#endif // ACCESSSET_H
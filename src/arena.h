@@ -0,0 +1,119 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+using namespace std;
+
+namespace Tm {
+
+/**
+ * \brief Bump allocator for objects that live exactly as long as one transaction.
+ *
+ * Objects are never freed one by one; reset() destroys all of them at once (in reverse order of creation)
+ * and rewinds the arena. Chunks are kept across resets, so an arena that is reused by subsequent
+ * transactions stops allocating once it reached the size of the largest transaction.
+ *
+ * Destructors are recorded only for types that need them, so e.g. buffers of ints cost nothing on reset.
+ */
+class Arena {
+public:
+	Arena() = default;
+
+	Arena(const Arena &) = delete;
+
+	~Arena() {
+		reset();
+		for(auto & c : chunks)
+			::operator delete(c.data);
+	}
+
+	/// constructs T from args in the arena
+	template <typename T, typename... Args>
+	T * create(Args&&... args) {
+		void * place = allocate(sizeof(T), alignof(T));
+		T * object = new (place) T(std::forward<Args>(args)...);
+		if(!is_trivially_destructible<T>::value)
+			destructors.push_back(Destructor{&destroy<T>, object});
+		return object;
+	}
+
+	/// raw memory; nothing is destroyed on reset
+	void * allocate(size_t size, size_t align) {
+		while(current < chunks.size()) {
+			Chunk & c = chunks[current];
+			// align the address rather than the offset: chunks themselves are aligned to max_align_t only
+			size_t start = ((uintptr_t(c.data) + used + align - 1) & ~uintptr_t(align - 1)) - uintptr_t(c.data);
+			if(start + size <= c.size) {
+				used = start + size;
+				return c.data + start;
+			}
+			// does not fit - try next chunk
+			++current;
+			used = 0;
+		}
+
+		size_t chunkSize = chunks.empty() ? initialChunkSize : chunks.back().size * 2;
+		while(chunkSize < size + align)
+			chunkSize *= 2;
+		// size + align leaves room for any padding the alignment needs
+		chunks.push_back(Chunk{static_cast<char*>(::operator new(chunkSize)), chunkSize});
+		current = chunks.size() - 1;
+		used = 0;
+		return allocate(size, align);
+	}
+
+	/// exchanges contents (objects and memory) with other
+	void swap(Arena & other) {
+		chunks.swap(other.chunks);
+		std::swap(current, other.current);
+		std::swap(used, other.used);
+		destructors.swap(other.destructors);
+	}
+
+	/// destroys all objects and makes the memory available again
+	void reset() {
+		for(auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+			it->destroy(it->object);
+		destructors.clear();
+		current = 0;
+		used = 0;
+	}
+
+protected:
+	static const size_t initialChunkSize = 4096;
+
+	struct Chunk {
+		char * data;
+		size_t size;
+	};
+
+	struct Destructor {
+		void (*destroy)(void*);
+		void * object;
+	};
+
+	template <typename T>
+	static void destroy(void * object) {
+		static_cast<T*>(object)->~T();
+	}
+
+	vector<Chunk> chunks;
+
+	/// chunk that is being filled
+	size_t current = 0;
+
+	/// bytes used in the current chunk
+	size_t used = 0;
+
+	vector<Destructor> destructors;
+};
+
+/*namespace TM end*/}
+
+#endif // ARENA_H
@@ -0,0 +1,127 @@
+#include "tmapi.h"
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+/*
+ * Thread churn: starts lots of short-lived threads, a few of them at a time,
+ * like a thread pool that keeps replacing its workers. Each thread runs a handful
+ * of transfer transactions and exits, so thread slots are taken and given back
+ * all the time. In the end the sum over all variables must be intact.
+ */
+
+// benchmark parameters:
+int totalThreads;
+int concurrentThreads;
+int transactionsPerThread;
+int varsNo;
+
+const int initialValue = 100;
+
+vector<Tm::Variable<int>*> vars;
+
+atomic<long long> commits {0};
+atomic<long long> aborts {0};
+
+void setup(int argc, char ** argv);
+
+void threadFunc(int seed){
+	default_random_engine generator(seed);
+	uniform_int_distribution<> varDist(0, varsNo-1);
+
+	for(int t = 0 ; t < transactionsPerThread; ++t){
+		int from = varDist(generator);
+		int to = varDist(generator);
+		while(true){
+			try{
+				Tm::beginT();
+				if(vars[from]->ro() > 0){
+					vars[from]->rw()--;
+					vars[to]->rw()++;
+				}
+				Tm::commitT();
+				commits.fetch_add(1, memory_order_relaxed);
+				break;
+			} catch(const Tm::InvalidUseException &) {
+				throw;
+			} catch(const Tm::TransactionException &) {
+				aborts.fetch_add(1, memory_order_relaxed);
+			}
+		}
+	}
+}
+
+int main(int argc, char ** argv){
+	setup(argc, argv);
+
+	for(int i = 0 ; i < varsNo; ++i)
+		vars.push_back(new Tm::Variable<int>(initialValue));
+
+	auto start = chrono::steady_clock::now();
+
+	int started = 0;
+	while(started < totalThreads){
+		vector<thread> wave;
+		for(int i = 0 ; i < concurrentThreads && started < totalThreads; ++i)
+			wave.emplace_back(threadFunc, started++);
+		for(auto & t : wave)
+			t.join();
+	}
+
+	auto stop = chrono::steady_clock::now();
+	double secs = chrono::duration<double>(stop-start).count();
+
+	long long endSum = 0;
+	Tm::beginT();
+	for(auto v : vars)
+		endSum += v->ro();
+	Tm::commitT();
+
+	printf("Threads: %d in %.2f s, %.0f threads/s\n", totalThreads, secs, totalThreads / secs);
+	printf("Commits: %lld, aborts: %lld\n", commits.load(), aborts.load());
+
+	if(endSum == (long long) initialValue * varsNo)
+		printf("All fine\n");
+	else
+		printf("TM problem - endSum!=varsSum\n");
+
+	for(auto v : vars)
+		delete v;
+
+	return endSum == (long long) initialValue * varsNo ? 0 : 1;
+}
+
+void setup(int argc, char ** argv){
+	boost::program_options::options_description opts;
+	opts.add_options()
+		("threads,n", boost::program_options::value<int>(&totalThreads)->default_value(5000), "Threads started in total")
+		("concurrent,c", boost::program_options::value<int>(&concurrentThreads)->default_value(8), "Threads running at the same time")
+		("transactions,x", boost::program_options::value<int>(&transactionsPerThread)->default_value(10), "Transactions per thread")
+		("vars,v", boost::program_options::value<int>(&varsNo)->default_value(64), "Number of variables")
+		("help,h", "this help")
+	;
+
+	boost::program_options::variables_map vm;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, opts), vm);
+	boost::program_options::notify(vm);
+
+	if (vm.count("help")) {
+		cout << opts << "\n";
+		exit(0);
+	}
+
+	if(totalThreads < 1 || concurrentThreads < 1 || (unsigned) concurrentThreads >= Tm::maxThreadNum || transactionsPerThread < 0 || varsNo < 1){
+		printf("Stupid arguments detected. Be gone!\n");
+		exit(1);
+	}
+
+	printf("Threads: %d (%d at once)\nTransactions/thread: %d\nVariables: %d\n", totalThreads, concurrentThreads, transactionsPerThread, varsNo);
+}
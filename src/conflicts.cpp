@@ -0,0 +1,96 @@
+#include "tmapi.h"
+#include "transaction.h"
+
+#include <algorithm>
+
+namespace Tm {
+
+namespace {
+
+/// names given by nameVariable()
+struct VariableNames {
+	mutex m;
+	unordered_map<const VariableBase *, string> names;
+};
+
+VariableNames & variableNames() {
+	static VariableNames n;
+	return n;
+}
+
+/*anonymous namespace end*/}
+
+void ConflictLog::addTo(unordered_map<const VariableBase *, VariableConflicts> & byVariable) const {
+	lock_guard<mutex> lock(m);
+	for(auto & c : counts){
+		VariableConflicts & v = byVariable[c.first.var];
+		v.var = c.first.var;
+		v.aborts += c.second.aborts;
+		v.kills += c.second.kills;
+		v.pairs.push_back(make_pair(make_pair(c.first.victim, c.first.culprit), c.second.aborts + c.second.kills));
+	}
+}
+
+void nameVariable(const VariableBase & var, const string & name) {
+	VariableNames & n = variableNames();
+	lock_guard<mutex> lock(n.m);
+	n.names[&var] = name;
+}
+
+vector<VariableConflicts> conflictHotspots(size_t n) {
+	vector<VariableConflicts> hot;
+#if TM_CONFLICTS
+	unordered_map<const VariableBase *, VariableConflicts> byVariable;
+	for(unsigned int slot = 0 ; slot < maxThreadNum; ++slot){
+		Transaction * t = Transaction::descriptorOfSlot(slot);
+		if(t)
+			t->conflictLog().addTo(byVariable);
+	}
+
+	for(auto & v : byVariable)
+		hot.push_back(move(v.second));
+	sort(hot.begin(), hot.end(), [](const VariableConflicts & a, const VariableConflicts & b){
+		return a.wasted() != b.wasted() ? a.wasted() > b.wasted() : a.var < b.var;
+	});
+	if(hot.size() > n)
+		hot.resize(n);
+
+	VariableNames & names = variableNames();
+	lock_guard<mutex> lock(names.m);
+	for(VariableConflicts & v : hot){
+		auto name = names.names.find(v.var);
+		if(name != names.names.end())
+			v.name = name->second;
+
+		// the victim's log has its aborts, the culprit's its kills: merge pairs found in both
+		sort(v.pairs.begin(), v.pairs.end());
+		size_t kept = 0;
+		for(size_t i = 0 ; i < v.pairs.size(); ++i){
+			if(kept && v.pairs[kept - 1].first == v.pairs[i].first)
+				v.pairs[kept - 1].second += v.pairs[i].second;
+			else
+				v.pairs[kept++] = v.pairs[i];
+		}
+		v.pairs.resize(kept);
+		stable_sort(v.pairs.begin(), v.pairs.end(), [](const pair<pair<unsigned int, unsigned int>, uint64_t> & a,
+		                                               const pair<pair<unsigned int, unsigned int>, uint64_t> & b){
+			return a.second > b.second;
+		});
+	}
+#else
+	(void) n;
+#endif
+	return hot;
+}
+
+void resetConflicts() {
+#if TM_CONFLICTS
+	for(unsigned int slot = 0 ; slot < maxThreadNum; ++slot){
+		Transaction * t = Transaction::descriptorOfSlot(slot);
+		if(t)
+			t->conflictLog().clear();
+	}
+#endif
+}
+
+/*namespace TM end*/}
@@ -0,0 +1,102 @@
+#ifndef CONFLICTS_H
+#define CONFLICTS_H
+
+/**
+ * \file conflicts.h
+ * \brief Conflict profile: which variables cost transactions, and who lost to whom over them (see Tm::conflictHotspots).
+ *
+ * Only built with TM_CONFLICTS=1 (CMake option TM_CONFLICTS). Otherwise the descriptor has no log and
+ * the hooks compile to nothing.
+ *
+ * Two kinds of wasted transactions are counted, each once:
+ *  – aborts: a transaction gave up on touching the variable itself: found it dirty on read, locked or used by the
+ *    irrevocable transaction on write, or locked when going irrevocable. The culprit is the transaction in the way,
+ *    as far as the variable tells: the irrevocable one, or the last one that locked it.
+ *  – kills: a committing writer of the variable killed a reader of it, or the irrevocable transaction stopped the
+ *    one holding its lock. The victim notices later, wherever it happens to be, so the killer records it.
+ *
+ * Each thread slot keeps its own log under its own mutex, which nobody else takes but for reading or clearing it,
+ * so threads do not contend. Variables are known by address: one freed and another created at its place count as one.
+ */
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef TM_CONFLICTS
+ #define TM_CONFLICTS 0
+#endif
+
+using namespace std;
+
+namespace Tm {
+
+class VariableBase;
+
+/// culprit that cannot be told, e.g. the lock owner finished and nobody locked the variable since
+const unsigned int unknownSlot = ~0u;
+
+/// transactions lost over one variable, see conflictHotspots()
+struct VariableConflicts {
+	const VariableBase * var = nullptr;
+	/// as given to nameVariable(), empty if none
+	string name;
+	uint64_t aborts = 0;
+	uint64_t kills = 0;
+	/// (victim slot, culprit slot) and transactions the victim lost to the culprit over var, most first
+	vector<pair<pair<unsigned int, unsigned int>, uint64_t>> pairs;
+
+	uint64_t wasted() const {return aborts + kills;}
+};
+
+/// conflicts recorded by one thread slot
+class ConflictLog {
+public:
+	enum Kind {abort, kill};
+
+	void add(const VariableBase * var, unsigned int victim, unsigned int culprit, Kind kind) {
+		lock_guard<mutex> lock(m);
+		Counts & c = counts[Key{var, victim, culprit}];
+		++(kind == abort ? c.aborts : c.kills);
+	}
+
+	/// adds what the log holds to byVariable
+	void addTo(unordered_map<const VariableBase *, VariableConflicts> & byVariable) const;
+
+	void clear() {
+		lock_guard<mutex> lock(m);
+		counts.clear();
+	}
+
+private:
+	struct Key {
+		const VariableBase * var;
+		unsigned int victim;
+		unsigned int culprit;
+
+		bool operator == (const Key & other) const {
+			return var == other.var && victim == other.victim && culprit == other.culprit;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator () (const Key & k) const {
+			return hash<const void *>()(k.var) ^ (size_t(k.victim) << 16) ^ (size_t(k.culprit) << 40);
+		}
+	};
+
+	struct Counts {
+		uint64_t aborts = 0;
+		uint64_t kills = 0;
+	};
+
+	mutable mutex m;
+	unordered_map<Key, Counts, KeyHash> counts;
+};
+
+/*namespace TM end*/}
+
+#endif // CONFLICTS_H
@@ -0,0 +1,122 @@
+#include "contention.h"
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+namespace Tm {
+
+namespace {
+
+/// xorshift; good enough for jitter, and cheaper than anything in <random>
+thread_local uint32_t jitterState = 0;
+
+uint32_t jitter() {
+	if(!jitterState)
+		jitterState = uint32_t(hash<thread::id>()(this_thread::get_id())) | 1;
+	jitterState ^= jitterState << 13;
+	jitterState ^= jitterState >> 17;
+	jitterState ^= jitterState << 5;
+	return jitterState;
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield");
+#endif
+}
+
+/// spins for given number of pause instructions, or less if until() becomes true
+template <typename Until>
+void spin(unsigned int spins, Until until) {
+	for(unsigned int i = 0 ; i < spins && !until(); ++i) {
+		cpuRelax();
+		// on an oversubscribed machine the thread we wait for may need our core
+		if((i & 1023) == 1023)
+			this_thread::yield();
+	}
+}
+
+/// source of timestamps for TimestampPriority; 0 is never handed out
+atomic<uint64_t> priorityClock {0};
+
+/// timestamp of the transaction that holds the priority, 0 if none
+atomic<uint64_t> priorityHolder {0};
+
+/// gives the priority up, if timestamp holds it
+void releasePriority(uint64_t timestamp) {
+	if(timestamp)
+		priorityHolder.compare_exchange_strong(timestamp, 0, memory_order_acq_rel, memory_order_relaxed);
+}
+
+/// history of this thread; a thread exiting while its transaction holds the priority gives it up
+struct ThreadHistory {
+	AbortHistory history;
+
+	~ThreadHistory() {
+		releasePriority(history.timestamp);
+	}
+};
+
+thread_local ThreadHistory myHistory;
+
+/*anonymous namespace end*/}
+
+AbortHistory & abortHistory() {
+	return myHistory.history;
+}
+
+void ExponentialBackoff::backOff(const AbortHistory & history) {
+	unsigned int doublings = history.retry ? history.retry - 1 : 0;
+	doublings += unsigned(history.averageRetries);
+	doublings = min(doublings, 20u);
+
+	unsigned int window = unsigned(min<uint64_t>(uint64_t(minSpins) << doublings, maxSpins));
+	if(!window)
+		return;
+
+	spin(jitter() % window, [](){return false;});
+}
+
+bool TimestampPriority::beforeAttempt(AbortHistory & history) {
+	uint64_t holder = priorityHolder.load(memory_order_acquire);
+
+	// the oldest one can't lose anymore
+	if(holder && holder == history.timestamp)
+		return true;
+
+	// an older transaction struggles - let it through first; newcomers have not lost yet, so they go ahead
+	if(holder && history.retry && holder < history.timestamp)
+		spin(maxWaitSpins, [holder](){return priorityHolder.load(memory_order_relaxed) != holder;});
+
+	return false;
+}
+
+void TimestampPriority::afterAbort(AbortHistory & history) {
+	if(!history.timestamp)
+		history.timestamp = priorityClock.fetch_add(1, memory_order_relaxed) + 1;
+
+	uint64_t holder = priorityHolder.load(memory_order_relaxed);
+	while(!holder || holder > history.timestamp) {
+		if(priorityHolder.compare_exchange_weak(holder, history.timestamp, memory_order_acq_rel, memory_order_relaxed))
+			// we're the oldest now - no backing off
+			return;
+	}
+
+	if(holder != history.timestamp)
+		backOff(history);
+}
+
+void TimestampPriority::release(AbortHistory & history) {
+	releasePriority(history.timestamp);
+}
+
+ContentionManager & defaultContentionManager() {
+	static IrrevocableAfter manager;
+	return manager;
+}
+
+/*namespace TM end*/}
@@ -0,0 +1,148 @@
+#ifndef CONTENTION_H
+#define CONTENTION_H
+
+#include <cstdint>
+
+using namespace std;
+
+namespace Tm {
+
+/**
+ * \brief What the transactions of one thread went through lately.
+ *
+ * Kept up to date by Tm::atomically (hand-written retry loops can do the same with the record* functions)
+ * and handed to the contention manager, so that policies can tell a hot spot from bad luck.
+ */
+struct AbortHistory {
+	/// aborts of the current transaction so far; 0 on its first attempt
+	unsigned int retry = 0;
+
+	/// totals of this thread
+	uint64_t commits = 0;
+	uint64_t aborts = 0;
+
+	/// moving average of how many retries the recent transactions of this thread needed
+	double averageRetries = 0;
+
+	/// priority of the current transaction, if a policy gave it one (0 otherwise)
+	uint64_t timestamp = 0;
+
+	/// call before the first attempt of a transaction
+	void newTransaction() {
+		retry = 0;
+		timestamp = 0;
+	}
+
+	void recordAbort() {
+		++retry;
+		++aborts;
+	}
+
+	void recordCommit() {
+		++commits;
+		averageRetries += (retry - averageRetries) / 8;
+	}
+};
+
+/// \returns history of this thread
+AbortHistory & abortHistory();
+
+/**
+ * \brief Decides how aborted transactions are retried.
+ *
+ * One object may be shared by all threads, so anything a policy remembers about a thread goes to its
+ * AbortHistory (or to thread-local storage). Hooks are called in this order for each transaction:
+ * beforeAttempt, then afterAbort and beforeAttempt again for every retry, then afterCommit or afterGiveUp.
+ */
+class ContentionManager {
+public:
+	virtual ~ContentionManager() {}
+
+	/// \returns true if the attempt shall become irrevocable right after it begins
+	virtual bool beforeAttempt(AbortHistory &) {return false;}
+
+	/// called once history recorded the abort; the place to back off
+	virtual void afterAbort(AbortHistory &) {}
+
+	virtual void afterCommit(AbortHistory &) {}
+
+	/// called when the transaction won't be retried anymore without having committed
+	virtual void afterGiveUp(AbortHistory &) {}
+};
+
+/**
+ * \brief Randomized exponential backoff that spins instead of sleeping.
+ *
+ * After the n-th abort the thread spins for a random number of pause instructions below
+ * minSpins * 2^(n-1), capped at maxSpins. Threads whose recent transactions needed many retries
+ * start with a proportionally larger window, so a hot spot calms down sooner.
+ * Once in a while the thread yields, as spinning won't help a lock owner that is preempted.
+ */
+class ExponentialBackoff : public ContentionManager {
+public:
+	explicit ExponentialBackoff(unsigned int minSpins = 64, unsigned int maxSpins = 1u << 16) : minSpins(minSpins), maxSpins(maxSpins) {}
+
+	void afterAbort(AbortHistory & history) override {
+		backOff(history);
+	}
+
+protected:
+	const unsigned int minSpins;
+	const unsigned int maxSpins;
+
+	void backOff(const AbortHistory & history);
+};
+
+/// the "n-th retry becomes irrevocable" rule, backing off exponentially until then
+class IrrevocableAfter : public ExponentialBackoff {
+public:
+	explicit IrrevocableAfter(unsigned int retries = 8, unsigned int minSpins = 64, unsigned int maxSpins = 1u << 16) :
+		ExponentialBackoff(minSpins, maxSpins), retries(retries) {}
+
+	bool beforeAttempt(AbortHistory & history) override {
+		return history.retry >= retries;
+	}
+
+protected:
+	const unsigned int retries;
+};
+
+/**
+ * \brief Oldest retrying transaction goes first.
+ *
+ * A transaction gets a timestamp on its first abort; the oldest timestamp among the retrying
+ * transactions holds the priority. The holder retries at once and as irrevocable, so that it can't
+ * lose again, while the other retrying transactions back off exponentially and then wait for
+ * the holder to finish, up to maxWaitSpins; newcomers go right ahead. So a transaction that keeps
+ * losing gains karma with its age until it wins. The priority is given up on commit, on giving up,
+ * and when the holder's thread exits.
+ */
+class TimestampPriority : public ExponentialBackoff {
+public:
+	explicit TimestampPriority(unsigned int maxWaitSpins = 1u << 16, unsigned int minSpins = 64, unsigned int maxSpins = 1u << 16) :
+		ExponentialBackoff(minSpins, maxSpins), maxWaitSpins(maxWaitSpins) {}
+
+	bool beforeAttempt(AbortHistory & history) override;
+
+	void afterAbort(AbortHistory & history) override;
+
+	void afterCommit(AbortHistory & history) override {
+		release(history);
+	}
+
+	void afterGiveUp(AbortHistory & history) override {
+		release(history);
+	}
+
+protected:
+	const unsigned int maxWaitSpins;
+
+	void release(AbortHistory & history);
+};
+
+/// \returns manager used by Tm::atomically unless told otherwise: IrrevocableAfter with default parameters
+ContentionManager & defaultContentionManager();
+
+/*namespace TM end*/}
+
+#endif // CONTENTION_H
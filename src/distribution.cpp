@@ -0,0 +1,121 @@
+#include "distribution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace Bench {
+
+bool Distribution::setup(const string & spec, int n, int threads, unsigned seed) {
+	this->spec = spec;
+	this->n = n;
+	this->threads = threads;
+	if(n < 1 || threads < 1)
+		return false;
+
+	stringstream ss(spec);
+	string name;
+	getline(ss, name, ':');
+	vector<double> params;
+	string param;
+	while(getline(ss, param, ':')){
+		char * end;
+		params.push_back(strtod(param.c_str(), &end));
+		if(param.empty() || *end)
+			return false;
+	}
+
+	if(name == "uniform" && params.empty())
+		kind = uniform;
+	else if(name == "zipf" && params.size() == 1 && params[0] >= 0 && params[0] < 1)
+		kind = zipf;
+	else if(name == "hotspot" && params.size() == 2 && params[0] >= 0 && params[0] <= 100 && params[1] > 0 && params[1] <= 100)
+		kind = hotspot;
+	else if(name == "partitioned" && params.empty())
+		kind = partitioned;
+	else if(name == "sequential" && params.empty())
+		kind = sequential;
+	else
+		return false;
+
+	if(kind == partitioned || kind == sequential)
+		return n / threads >= 1;
+
+	if(kind == zipf || kind == hotspot){
+		permutation.resize(n);
+		for(int i = 0 ; i < n; ++i)
+			permutation[i] = i;
+		default_random_engine generator(seed);
+		shuffle(permutation.begin(), permutation.end(), generator);
+	}
+
+	if(kind == zipf){
+		theta = params[0];
+		zetaN = 0;
+		for(int i = 1 ; i <= n; ++i)
+			zetaN += 1 / pow(i, theta);
+		zeta2 = 1 + pow(0.5, theta);
+		alpha = 1 / (1 - theta);
+		eta = n > 1 ? (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetaN) : 0;
+	}
+
+	if(kind == hotspot){
+		hotFraction = params[0] / 100;
+		hotVariables = max(1, (int) lround(n * params[1] / 100));
+	}
+
+	return true;
+}
+
+int Distribution::reach() const {
+	if(kind == partitioned || kind == sequential)
+		return n / threads;
+	if(kind == hotspot && hotFraction == 1)
+		return hotVariables;
+	// all goes to the cold set, unless there is none
+	if(kind == hotspot && hotFraction == 0 && hotVariables < n)
+		return n - hotVariables;
+	return n;
+}
+
+int Distribution::zipfRank(default_random_engine & generator) const {
+	double u = uniform_real_distribution<>(0, 1)(generator);
+	double uz = u * zetaN;
+	if(uz < 1)
+		return 0;
+	if(uz < zeta2)
+		return min(1, n - 1);
+	return min(n - 1, (int) (n * pow(eta * u - eta + 1, alpha)));
+}
+
+Distribution::Picker::Picker(const Distribution & d, int thread) : d(d), first(0), size(d.n) {
+	if(d.kind == partitioned || d.kind == sequential){
+		// -1 (not a worker) gets the first partition
+		int t = max(thread, 0) % d.threads;
+		first = (long long) d.n * t / d.threads;
+		size = (long long) d.n * (t + 1) / d.threads - first;
+	}
+}
+
+int Distribution::Picker::next(default_random_engine & generator) {
+	switch(d.kind){
+		case uniform:
+		case partitioned:
+			return first + uniform_int_distribution<>(0, size - 1)(generator);
+		case sequential: {
+			int v = first + position;
+			position = position + 1 == size ? 0 : position + 1;
+			return v;
+		}
+		case zipf:
+			return d.permutation[d.zipfRank(generator)];
+		case hotspot:
+			if(d.hotVariables == d.n || uniform_real_distribution<>(0, 1)(generator) < d.hotFraction)
+				return d.permutation[uniform_int_distribution<>(0, d.hotVariables - 1)(generator)];
+			return d.permutation[uniform_int_distribution<>(d.hotVariables, d.n - 1)(generator)];
+	}
+	return 0;
+}
+
+/*namespace Bench end*/}
@@ -0,0 +1,89 @@
+#ifndef DISTRIBUTION_H
+#define DISTRIBUTION_H
+
+/**
+ * \file distribution.h
+ * \brief Which of n variables benchmark transactions access: uniform, Zipf, hotspot, or a partition per thread.
+ *
+ * A Distribution is set up once from a spec and shared by all threads; each thread draws from it through
+ * its own Picker. Zipf and hotspot ranks are mapped onto variables through a fixed random permutation,
+ * so that hot variables are scattered over memory rather than packed next to each other.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Bench {
+
+class Distribution {
+public:
+	enum Kind {
+		/// every variable equally likely
+		uniform,
+		/// the variable of rank i picked with probability ∝ 1/(i+1)^θ, 0 ≤ θ < 1 (YCSB uses 0.99)
+		zipf,
+		/// x% of accesses go to y% of the variables, the rest to the others; both uniform within
+		hotspot,
+		/// thread t uses only its own n/threads variables, uniformly
+		partitioned,
+		/// thread t walks its own n/threads variables one after another, round and round
+		sequential
+	};
+
+	/**
+	 * \brief Parses spec: uniform, zipf:θ, hotspot:x:y, partitioned or sequential
+	 * \returns false if spec is malformed or does not fit n variables and `threads` threads
+	 */
+	bool setup(const string & spec, int n, int threads, unsigned seed);
+
+	/// fewest distinct variables a single thread can get
+	int reach() const;
+
+	const string & name() const {return spec;}
+
+	/// per-thread state of drawing from a Distribution
+	class Picker {
+	public:
+		Picker(const Distribution & d, int thread);
+
+		/// \returns index of the next variable
+		int next(default_random_engine & generator);
+
+	private:
+		const Distribution & d;
+		/// the part of the variables this thread may use (all but for partitioned and sequential)
+		int first;
+		int size;
+		/// next of the sequential walk
+		int position = 0;
+	};
+
+private:
+	string spec;
+	Kind kind = uniform;
+	int n = 0;
+	int threads = 1;
+
+	/// rank -> variable, for zipf and hotspot
+	vector<int> permutation;
+
+	// zipf, as in J. Gray et al., "Quickly generating billion-record synthetic databases", SIGMOD 1994
+	double theta = 0;
+	double zetaN = 0;
+	double zeta2 = 0;
+	double alpha = 0;
+	double eta = 0;
+
+	// hotspot
+	double hotFraction = 0;
+	int hotVariables = 0;
+
+	int zipfRank(default_random_engine & generator) const;
+};
+
+/*namespace Bench end*/}
+
+#endif // DISTRIBUTION_H
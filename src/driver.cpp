@@ -0,0 +1,383 @@
+#include "driver.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace Bench {
+
+namespace {
+
+thread_local int currentThread = -1;
+
+void beGone() {
+	printf("Stupid arguments detected. Be gone!\n");
+	exit(1);
+}
+
+/// parses a list such as 0-3,8 into cpus; \returns false if it is not one
+bool parseCpuList(const string & text, vector<int> & cpus) {
+	stringstream ss(text);
+	string part;
+	while(getline(ss, part, ',')){
+		int first, last;
+		char dash;
+		stringstream range(part);
+		if(!(range >> first) || first < 0)
+			return false;
+		last = first;
+		if(range >> dash && (dash != '-' || !(range >> last) || last < first))
+			return false;
+		if(!range.eof())
+			return false;
+		for(int cpu = first ; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+	}
+	return !cpus.empty();
+}
+
+string jsonString(const string & s) {
+	string out = "\"";
+	for(char c : s){
+		if(c == '"' || c == '\\')
+			out += '\\';
+		out += c;
+	}
+	return out + "\"";
+}
+
+/// metric name -> mean and (sample) standard deviation over the windows
+vector<pair<string, pair<double, double>>> summarize(const vector<Metrics> & windows) {
+	vector<pair<string, pair<double, double>>> summary;
+	if(windows.empty())
+		return summary;
+	for(size_t m = 0 ; m < windows[0].size(); ++m){
+		double sum = 0, sumSq = 0;
+		for(const Metrics & w : windows)
+			sum += w[m].second;
+		double mean = sum / windows.size();
+		for(const Metrics & w : windows)
+			sumSq += (w[m].second - mean) * (w[m].second - mean);
+		double stddev = windows.size() > 1 ? sqrt(sumSq / (windows.size() - 1)) : 0;
+		summary.push_back(make_pair(windows[0][m].first, make_pair(mean, stddev)));
+	}
+	return summary;
+}
+
+/*anonymous namespace end*/}
+
+int threadIndex() {
+	return currentThread;
+}
+
+// Options
+
+Options & Options::add(Option option) {
+	options.push_back(option);
+	return *this;
+}
+
+Options & Options::add(const char * name, char shortName, int & target, int def, const char * help) {
+	target = def;
+	return add(Option{name, shortName, false, help,
+		[&target](const string & text){
+			char * end;
+			long v = strtol(text.c_str(), &end, 10);
+			if(text.empty() || *end || v != (int) v)
+				return false;
+			target = v;
+			return true;
+		},
+		[&target](){return to_string(target);}});
+}
+
+Options & Options::add(const char * name, char shortName, unsigned & target, unsigned def, const char * help) {
+	target = def;
+	return add(Option{name, shortName, false, help,
+		[&target](const string & text){
+			char * end;
+			unsigned long v = strtoul(text.c_str(), &end, 10);
+			if(text.empty() || *end || text[0] == '-' || v != (unsigned) v)
+				return false;
+			target = v;
+			return true;
+		},
+		[&target](){return to_string(target);}});
+}
+
+Options & Options::add(const char * name, char shortName, double & target, double def, const char * help) {
+	target = def;
+	return add(Option{name, shortName, false, help,
+		[&target](const string & text){
+			char * end;
+			double v = strtod(text.c_str(), &end);
+			if(text.empty() || *end)
+				return false;
+			target = v;
+			return true;
+		},
+		[&target](){
+			ostringstream ss;
+			ss << target;
+			return ss.str();
+		}});
+}
+
+Options & Options::add(const char * name, char shortName, string & target, const string & def, const char * help) {
+	target = def;
+	return add(Option{name, shortName, false, help,
+		[&target](const string & text){
+			target = text;
+			return true;
+		},
+		[&target](){return target;}});
+}
+
+Options & Options::addSwitch(const char * name, char shortName, bool & target, const char * help) {
+	target = false;
+	return add(Option{name, shortName, true, help,
+		[&target](const string &){
+			target = true;
+			return true;
+		},
+		[&target](){return string(target ? "true" : "false");}});
+}
+
+const Options::Option * Options::find(const string & arg) const {
+	for(const Option & o : options)
+		if(arg.size() > 2 ? arg.compare(2, string::npos, o.name) == 0 : (o.shortName && arg[1] == o.shortName))
+			return &o;
+	return nullptr;
+}
+
+void Options::parse(int argc, char ** argv) {
+	for(int i = 1 ; i < argc; ++i){
+		string arg = argv[i];
+		if(arg == "-h" || arg == "--help"){
+			printHelp();
+			exit(0);
+		}
+		if(arg.size() < 2 || arg[0] != '-'){
+			printf("Unexpected argument: %s\n", arg.c_str());
+			beGone();
+		}
+
+		// --name=value and -nvalue carry the value along
+		string value;
+		bool hasValue = false;
+		if(arg[1] == '-'){
+			size_t eq = arg.find('=');
+			if(eq != string::npos){
+				value = arg.substr(eq + 1);
+				arg.resize(eq);
+				hasValue = true;
+			}
+		} else if(arg.size() > 2){
+			value = arg.substr(2);
+			arg.resize(2);
+			hasValue = true;
+		}
+
+		const Option * o = find(arg);
+		if(!o || (o->isSwitch && hasValue)){
+			printf("Unknown option: %s\n", argv[i]);
+			beGone();
+		}
+		if(!o->isSwitch && !hasValue){
+			if(i + 1 == argc){
+				printf("Missing value of %s\n", arg.c_str());
+				beGone();
+			}
+			value = argv[++i];
+		}
+		if(!o->set(value)){
+			printf("Bad value of %s: %s\n", arg.c_str(), value.c_str());
+			beGone();
+		}
+	}
+}
+
+vector<pair<string, string>> Options::values() const {
+	vector<pair<string, string>> v;
+	for(const Option & o : options)
+		v.push_back(make_pair(o.name, o.show()));
+	return v;
+}
+
+void Options::printHelp() const {
+	for(const Option & o : options){
+		string flags = o.shortName ? string("-") + o.shortName + " [ --" + o.name + " ]" : "--" + o.name;
+		if(!o.isSwitch)
+			flags += " arg (=" + o.show() + ")";
+		printf("  %-36s %s\n", flags.c_str(), o.help.c_str());
+	}
+	printf("  %-36s %s\n", "-h [ --help ]", "this help");
+}
+
+// Driver
+
+Driver::Driver(const char * benchmark) : benchmark(benchmark), window(notStarted) {}
+
+void Driver::addOptions(Options & opts, int defaultThreads) {
+	opts.add("threads", 't', threads, defaultThreads, "Thread number")
+	    .add("seconds", 's', seconds, 1, "Length of each measured window in seconds")
+	    .add("warmup", 'W', warmupSecs, 0.5, "Warmup before the first window in seconds (its results are dropped)")
+	    .add("repetitions", 'R', repetitions, 3, "Measured windows (mean ± standard deviation is reported)")
+	    .add("pin", 'P', pin, "none", "Pin workers to CPUs: none, compact (i-th worker on i-th allowed CPU) or a list such as 0-3,8")
+	    .add("seed", 0, seed, 1, "Seed of the random engines (each thread gets its own from it)")
+	    .add("json", 0, jsonFile, "", "Write options, build configuration and results as JSON to this file")
+	    .add("csv", 0, csvFile, "", "Write results as CSV to this file")
+	    .addSwitch("perf", 0, perf, "Count cycles, instructions, cache and branch misses and context switches per transaction");
+}
+
+bool Driver::setup(const Options & opts) {
+	if(threads < 1 || seconds <= 0 || warmupSecs < 0 || repetitions < 1)
+		return false;
+
+	cpus.clear();
+	if(pin == "compact"){
+		cpu_set_t allowed;
+		if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+			for(int cpu = 0 ; cpu < CPU_SETSIZE; ++cpu)
+				if(CPU_ISSET(cpu, &allowed))
+					cpus.push_back(cpu);
+		if(cpus.empty())
+			fprintf(stderr, "Cannot read CPUs allowed, workers stay unpinned\n");
+	} else if(pin != "none" && !parseCpuList(pin, cpus))
+		return false;
+
+	parameters = opts.values();
+	return true;
+}
+
+void Driver::setThreadIndex(int thread) {
+	currentThread = thread;
+}
+
+void Driver::pinWorker(int thread) const {
+	if(cpus.empty())
+		return;
+	int cpu = cpus[thread % cpus.size()];
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(cpu < CPU_SETSIZE)
+		CPU_SET(cpu, &set);
+	if(cpu >= CPU_SETSIZE || pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		fprintf(stderr, "Cannot pin worker %d to CPU %d, it stays unpinned\n", thread, cpu);
+}
+
+vector<double> Driver::timeWindows(const function<void()> & onMeasure) {
+	typedef chrono::steady_clock Clock;
+	vector<double> lengths;
+
+	window.store(-1, memory_order_relaxed);
+	this_thread::sleep_for(chrono::duration<double>(warmupSecs));
+
+	if(onMeasure)
+		onMeasure();
+
+	Clock::duration length = chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+	Clock::time_point start = Clock::now();
+	for(int w = 0 ; w < repetitions; ++w){
+		window.store(w, memory_order_relaxed);
+		this_thread::sleep_until(start + length);
+		Clock::time_point stop = Clock::now();
+		lengths.push_back(chrono::duration<double>(stop - start).count());
+		start = stop;
+	}
+	window.store(repetitions, memory_order_relaxed);
+
+	return lengths;
+}
+
+void Driver::reportUnavailable(const PerfCounters & counters) {
+	if(perfReported)
+		return;
+	perfReported = true;
+	for(int k = 0 ; k < PerfCounts::kinds; ++k)
+		if(const char * why = counters.unavailable(PerfCounts::Kind(k)))
+			fprintf(stderr, "Cannot count %s (%s), it is left out\n", PerfCounts::name(PerfCounts::Kind(k)), why);
+}
+
+void Driver::report(const string & label, const vector<Metrics> & windows) {
+	if(!label.empty())
+		printf("\n%s:\n", label.c_str());
+	for(auto & m : summarize(windows)){
+		// figures per transaction can be well below 1
+		int digits = fabs(m.second.first) < 10 ? 4 : 1;
+		printf("%-24s %14.*f ± %.*f\n", (m.first + ":").c_str(), digits, m.second.first, digits, m.second.second);
+	}
+	results.push_back(RunResult{label, windows});
+}
+
+void Driver::finish() const {
+	if(!jsonFile.empty()){
+		FILE * f = fopen(jsonFile.c_str(), "w");
+		if(!f)
+			perror(jsonFile.c_str());
+		else {
+			fprintf(f, "{\n  \"benchmark\": %s,\n", jsonString(benchmark).c_str());
+			fprintf(f, "  \"build\": {\"metadata\": \"%s\", \"layout\": \"%s\", \"compiler\": %s, \"optimized\": %s},\n",
+			        TM_METADATA == TM_METADATA_STRIPED ? "striped" : "per-variable",
+			        TM_LAYOUT == TM_LAYOUT_SPLIT ? "split" : TM_LAYOUT == TM_LAYOUT_PADDED ? "padded" : "dense",
+			        jsonString(__VERSION__).c_str(),
+#ifdef __OPTIMIZE__
+			        "true"
+#else
+			        "false"
+#endif
+			       );
+			fprintf(f, "  \"parameters\": {");
+			for(size_t i = 0 ; i < parameters.size(); ++i)
+				fprintf(f, "%s%s: %s", i ? ", " : "", jsonString(parameters[i].first).c_str(), jsonString(parameters[i].second).c_str());
+			fprintf(f, "},\n  \"runs\": [");
+			for(size_t r = 0 ; r < results.size(); ++r){
+				const RunResult & run = results[r];
+				fprintf(f, "%s\n    {\"label\": %s,\n     \"windows\": [", r ? "," : "", jsonString(run.label).c_str());
+				for(size_t w = 0 ; w < run.windows.size(); ++w){
+					fprintf(f, "%s{", w ? ", " : "");
+					for(size_t m = 0 ; m < run.windows[w].size(); ++m)
+						fprintf(f, "%s%s: %.17g", m ? ", " : "", jsonString(run.windows[w][m].first).c_str(), run.windows[w][m].second);
+					fprintf(f, "}");
+				}
+				auto summary = summarize(run.windows);
+				fprintf(f, "],\n     \"mean\": {");
+				for(size_t m = 0 ; m < summary.size(); ++m)
+					fprintf(f, "%s%s: %.17g", m ? ", " : "", jsonString(summary[m].first).c_str(), summary[m].second.first);
+				fprintf(f, "},\n     \"stddev\": {");
+				for(size_t m = 0 ; m < summary.size(); ++m)
+					fprintf(f, "%s%s: %.17g", m ? ", " : "", jsonString(summary[m].first).c_str(), summary[m].second.second);
+				fprintf(f, "}}");
+			}
+			fprintf(f, "\n  ]\n}\n");
+			fclose(f);
+		}
+	}
+
+	if(!csvFile.empty()){
+		FILE * f = fopen(csvFile.c_str(), "w");
+		if(!f)
+			perror(csvFile.c_str());
+		else {
+			// long format: one row per figure; window is its number, mean or stddev
+			fprintf(f, "benchmark,label,window,metric,value\n");
+			for(const RunResult & run : results){
+				for(size_t w = 0 ; w < run.windows.size(); ++w)
+					for(auto & m : run.windows[w])
+						fprintf(f, "%s,%s,%zu,%s,%.17g\n", benchmark.c_str(), run.label.c_str(), w, m.first.c_str(), m.second);
+				for(auto & m : summarize(run.windows)){
+					fprintf(f, "%s,%s,mean,%s,%.17g\n", benchmark.c_str(), run.label.c_str(), m.first.c_str(), m.second.first);
+					fprintf(f, "%s,%s,stddev,%s,%.17g\n", benchmark.c_str(), run.label.c_str(), m.first.c_str(), m.second.second);
+				}
+			}
+			fclose(f);
+		}
+	}
+}
+
+/*namespace Bench end*/}
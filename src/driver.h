@@ -0,0 +1,232 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+/**
+ * \file driver.h
+ * \brief Benchmark driver: command line options, worker threads, warmup, repeated measurement windows,
+ * CPU pinning and JSON / CSV output, on nothing but the standard library (and Linux for pinning).
+ *
+ * A benchmark gives Driver::run a statistics type S (default constructible, with +=), an operation
+ * that each worker runs over and over on its own S, and a function that turns S summed over all
+ * threads in one window into named metrics. Workers run through the warmup and then through
+ * `repetitions` back-to-back windows of `seconds` each; each one records into a fresh S per window,
+ * and what it records during warmup is thrown away. The S of different threads never share a cache line.
+ *
+ * With --perf, each worker also counts cycles, instructions, cache and branch misses and context switches
+ * (see perfcounters.h) per window; metrics gets them summed over all threads, to normalize them by what S counted.
+ *
+ * Metrics are printed as mean ± standard deviation over the windows and, with --json / --csv,
+ * written out with all options and the build configuration, so that runs of different builds
+ * can be compared.
+ */
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "layout.h"
+#include "perfcounters.h"
+
+using namespace std;
+
+namespace Bench {
+
+/// command line options: --name value, --name=value, -n value, switches without value, -h / --help
+class Options {
+public:
+	Options & add(const char * name, char shortName, int & target, int def, const char * help);
+	Options & add(const char * name, char shortName, unsigned & target, unsigned def, const char * help);
+	Options & add(const char * name, char shortName, double & target, double def, const char * help);
+	Options & add(const char * name, char shortName, string & target, const string & def, const char * help);
+	/// an option without value; target is false unless it is given
+	Options & addSwitch(const char * name, char shortName, bool & target, const char * help);
+
+	/// sets all targets from argv; prints the help and exits on -h, exits on unknown options and malformed values
+	void parse(int argc, char ** argv);
+
+	/// name and current value of each option, in the order they were added
+	vector<pair<string, string>> values() const;
+
+private:
+	struct Option {
+		string name;
+		/// 0 if none
+		char shortName;
+		bool isSwitch;
+		string help;
+		/// \returns false if text is not a valid value
+		function<bool(const string & text)> set;
+		function<string()> show;
+	};
+
+	vector<Option> options;
+
+	Options & add(Option option);
+	const Option * find(const string & arg) const;
+	void printHelp() const;
+};
+
+/// named figures of one window, e.g. {"commits/s", 1.2e6}
+typedef vector<pair<string, double>> Metrics;
+
+/// statistics of a Driver::run summed over all threads and measured windows, and how long the windows took
+template <typename S>
+struct Outcome {
+	S total;
+	double seconds;
+};
+
+/// value alone on its cache lines
+template <typename T>
+struct Padded {
+	char padBefore[Tm::cacheLineSize];
+	T value;
+	char padAfter[Tm::cacheLineSize];
+};
+
+/// index of the calling worker thread (0 … threads-1), -1 outside of workers
+int threadIndex();
+
+class Driver {
+public:
+	// settings, filled in by the options
+	int threads;
+	double warmupSecs;
+	double seconds;
+	int repetitions;
+	/// none, compact (worker i on the i-th CPU the process may use) or a CPU list such as 0-3,8 (used round robin)
+	string pin;
+	unsigned seed;
+	string jsonFile;
+	string csvFile;
+	/// count hardware events per window (where the system allows it)
+	bool perf;
+
+	/// benchmark is the name results are recorded under
+	explicit Driver(const char * benchmark);
+
+	/// adds the options above to opts
+	void addOptions(Options & opts, int defaultThreads = 2);
+
+	/// checks the settings and remembers all options of opts to record them with the results; \returns false if settings make no sense
+	bool setup(const Options & opts);
+
+	/// seed for the random engine of thread (a worker index, or -1); the same seed gives the same sequence
+	unsigned seedFor(int thread) const {return seed + thread + 1;}
+
+	/**
+	 * \brief Runs op in `threads` worker threads through the warmup and all windows, prints metrics of the windows
+	 * \param label  names the run in the output (may be empty)
+	 * \param op     void(S &), called over and over until the window ends; it must not take long
+	 * \param metrics Metrics(const S & sumOfAllThreads, double windowSeconds, const PerfCounts & sumOfAllThreads)
+	 * \param onMeasure if set, called right before the first measured window (e.g. to reset counters)
+	 */
+	template <typename S, typename Op, typename Describe>
+	Outcome<S> run(const string & label, Op op, Describe metrics, function<void()> onMeasure = nullptr);
+
+	/// writes results of all runs to the JSON and CSV files, if asked for
+	void finish() const;
+
+private:
+	struct RunResult {
+		string label;
+		vector<Metrics> windows;
+	};
+
+	string benchmark;
+	vector<pair<string, string>> parameters;
+	vector<RunResult> results;
+	/// CPUs workers are pinned to, round robin; empty if they are not pinned
+	vector<int> cpus;
+
+	/// what workers shall do: notStarted, warmup (-1), record into window w (0 … repetitions-1), stop (repetitions)
+	atomic<int> window;
+	static const int notStarted = -2;
+
+	/// why counters are unavailable has been printed
+	bool perfReported = false;
+
+	static void setThreadIndex(int thread);
+	void pinWorker(int thread) const;
+	/// drives window through warmup and all windows; \returns how long each window took in seconds
+	vector<double> timeWindows(const function<void()> & onMeasure);
+	void report(const string & label, const vector<Metrics> & windows);
+	/// prints once which counters are unavailable and why
+	void reportUnavailable(const PerfCounters & counters);
+};
+
+template <typename S, typename Op, typename Describe>
+Outcome<S> Driver::run(const string & label, Op op, Describe metrics, function<void()> onMeasure) {
+	// per thread: warmup first, then the windows
+	const int slotsPerThread = repetitions + 1;
+	vector<Padded<S>> slots(threads * slotsPerThread);
+	vector<Padded<PerfCounts>> counts(perf ? threads * slotsPerThread : 0);
+	atomic<int> ready {0};
+	vector<thread> workers;
+
+	window.store(notStarted);
+
+	for(int i = 0 ; i < threads; ++i)
+		workers.emplace_back([&, i](){
+			setThreadIndex(i);
+			pinWorker(i);
+			unique_ptr<PerfCounters> counters;
+			if(perf){
+				counters.reset(new PerfCounters());
+				if(i == 0)
+					reportUnavailable(*counters);
+			}
+			++ready;
+			int w;
+			while((w = window.load(memory_order_relaxed)) == notStarted)
+				this_thread::yield();
+			PerfCounts last;
+			if(counters)
+				last = counters->read();
+			while(w < repetitions){
+				op(slots[i * slotsPerThread + w + 1].value);
+				int now = window.load(memory_order_relaxed);
+				// counters are read only when the window changes, so they cost nothing per op
+				if(now != w && counters){
+					PerfCounts current = counters->read();
+					counts[i * slotsPerThread + w + 1].value = current - last;
+					last = current;
+				}
+				w = now;
+			}
+		});
+
+	while(ready != threads)
+		this_thread::yield();
+
+	vector<double> lengths = timeWindows(onMeasure);
+
+	for(thread & t : workers)
+		t.join();
+
+	Outcome<S> outcome {S(), 0};
+	vector<Metrics> windows;
+	for(int w = 0 ; w < repetitions; ++w){
+		S sum;
+		PerfCounts events;
+		for(int i = 0 ; i < threads; ++i){
+			sum += slots[i * slotsPerThread + w + 1].value;
+			if(perf)
+				events += counts[i * slotsPerThread + w + 1].value;
+		}
+		windows.push_back(metrics(sum, lengths[w], events));
+		outcome.total += sum;
+		outcome.seconds += lengths[w];
+	}
+
+	report(label, windows);
+	return outcome;
+}
+
+/*namespace Bench end*/}
+
+#endif // DRIVER_H
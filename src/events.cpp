@@ -0,0 +1,129 @@
+#include "tmapi.h"
+#include "transaction.h"
+
+#include <cstdio>
+#include <thread>
+
+namespace Tm {
+
+#if TM_EVENTS
+
+size_t eventsPerSlot = size_t(1) << 16;
+
+namespace {
+
+/// an event clock reading together with steady_clock, to turn event time stamps into microseconds
+struct ClockSample {
+	uint64_t ticks;
+	double us;
+
+	static ClockSample now() {
+		return ClockSample{eventClock(), chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count()};
+	}
+};
+
+/// taken at startup, before any transaction
+const ClockSample origin = ClockSample::now();
+
+const char * eventName(EventKind kind) {
+	switch(kind) {
+		case EventKind::begin:       return "begin";
+		case EventKind::firstRead:   return "first read";
+		case EventKind::firstWrite:  return "first write";
+		case EventKind::irrevocable: return "irrevocable";
+		case EventKind::kill:        return "kill";
+		case EventKind::hijack:      return "hijack";
+		case EventKind::commit:      return "commit";
+		case EventKind::abort:       return "abort";
+	}
+	return "?";
+}
+
+/// what the arg of kind is called in the trace, nullptr if it has none worth showing
+const char * argName(EventKind kind) {
+	switch(kind) {
+		case EventKind::irrevocable: return "waited [us]";
+		case EventKind::kill:        return "victim slot";
+		case EventKind::hijack:      return "owner slot";
+		default:                     return nullptr;
+	}
+}
+
+/*anonymous namespace end*/}
+
+bool dumpEvents(const string & file) {
+	ClockSample now = ClockSample::now();
+	if(now.us - origin.us < 10000){
+		// too short to tell the tick rate
+		this_thread::sleep_for(chrono::milliseconds(10));
+		now = ClockSample::now();
+	}
+	double ticksPerUs = (now.ticks - origin.ticks) / (now.us - origin.us);
+
+	FILE * f = fopen(file.c_str(), "w");
+	if(!f)
+		return false;
+
+	fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+	bool first = true;
+	auto separate = [&](){
+		if(!first)
+			fprintf(f, ",\n");
+		first = false;
+	};
+
+	for(unsigned int slot = 0 ; slot < maxThreadNum; ++slot){
+		Transaction * t = Transaction::descriptorOfSlot(slot);
+		if(!t)
+			continue;
+
+		separate();
+		fprintf(f, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"slot %u\"}}", slot, slot);
+
+		// begin of the transaction the events belong to; false until one has been seen
+		bool inTransaction = false;
+		double beginUs = 0;
+		t->eventRing().forEach([&](const Event & e){
+			double us = (double(e.timestamp) - double(origin.ticks)) / ticksPerUs;
+			if(e.kind == EventKind::begin){
+				inTransaction = true;
+				beginUs = us;
+				return;
+			}
+			separate();
+			if((e.kind == EventKind::commit || e.kind == EventKind::abort) && inTransaction){
+				// the whole transaction as one span
+				if(e.kind == EventKind::commit)
+					fprintf(f, "{\"name\": \"%s\", ", e.arg ? "irrevocable commit" : "commit");
+				else
+					fprintf(f, "{\"name\": \"abort: %s\", ", abortReasonName(AbortReason(e.arg)));
+				fprintf(f, "\"cat\": \"tx\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u}", beginUs, us - beginUs, slot);
+				inTransaction = false;
+				return;
+			}
+			// an instant, or the end of a transaction whose begin has been overwritten already
+			if(e.kind == EventKind::abort)
+				fprintf(f, "{\"name\": \"abort: %s\", ", abortReasonName(AbortReason(e.arg)));
+			else
+				fprintf(f, "{\"name\": \"%s\", ", eventName(e.kind));
+			fprintf(f, "\"cat\": \"tx\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u", us, slot);
+			if(const char * arg = argName(e.kind))
+				fprintf(f, ", \"args\": {\"%s\": %u}", arg, e.arg);
+			fprintf(f, "}");
+		});
+	}
+
+	fprintf(f, "\n]}\n");
+	return fclose(f) == 0;
+}
+
+#else
+
+bool dumpEvents(const string &) {
+	// nothing has been recorded
+	return false;
+}
+
+#endif
+
+/*namespace TM end*/}
@@ -0,0 +1,107 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+/**
+ * \file events.h
+ * \brief Lifecycle events of transactions (begin, first read / write, irrevocability, kills, hijacks, commit, abort),
+ * recorded per thread slot into a ring buffer and dumped by Tm::dumpEvents.
+ *
+ * Only built with TM_EVENTS=1 (CMake option TM_EVENTS). Otherwise the descriptor has no ring and
+ * Transaction::trace() is empty, so the hooks compile to nothing.
+ *
+ * Each ring is written by the thread owning the slot only: an event is a time stamp and a store, no atomic
+ * read-modify-write and no shared cache line. When the ring is full, the oldest events are overwritten.
+ * Time stamps come from the time stamp counter where there is one (x86), from steady_clock elsewhere.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#if defined(__x86_64__) || defined(__i386__)
+ #include <x86intrin.h>
+#else
+ #include <chrono>
+#endif
+
+#ifndef TM_EVENTS
+ #define TM_EVENTS 0
+#endif
+
+using namespace std;
+
+namespace Tm {
+
+enum class EventKind : uint8_t {
+	/// arg: 1 if declared read-only
+	begin,
+	/// first variable read / written by the transaction
+	firstRead,
+	firstWrite,
+	/// became irrevocable; arg: microseconds waited in line
+	irrevocable,
+	/// a committing writer killed a reader, or the irrevocable transaction stopped a lock owner; arg: victim's slot
+	kill,
+	/// the irrevocable transaction took over the write buffer of a committing one; arg: its slot
+	hijack,
+	/// arg: 1 if irrevocable
+	commit,
+	/// arg: AbortReason
+	abort
+};
+
+struct Event {
+	uint64_t timestamp;
+	uint32_t arg;
+	EventKind kind;
+};
+
+/// \returns the time stamp events get: TSC ticks or steady_clock ticks
+inline uint64_t eventClock() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/// newest events of one thread slot; one writer, readers only when it is quiet
+class EventRing {
+public:
+	/// allocates room for capacity events, rounded up to a power of two
+	explicit EventRing(size_t capacity) : mask(roundUp(capacity) - 1), events(new Event[mask + 1]) {}
+
+	void record(EventKind kind, uint32_t arg) {
+		uint64_t n = written.load(memory_order_relaxed);
+		Event & e = events[n & mask];
+		e.timestamp = eventClock();
+		e.arg = arg;
+		e.kind = kind;
+		written.store(n + 1, memory_order_release);
+	}
+
+	/// calls f(const Event &) for the events kept, oldest first
+	template <typename F>
+	void forEach(F f) const {
+		uint64_t n = written.load(memory_order_acquire);
+		for(uint64_t i = n > mask ? n - mask - 1 : 0 ; i < n; ++i)
+			f(events[i & mask]);
+	}
+
+private:
+	const uint64_t mask;
+	unique_ptr<Event[]> events;
+	/// events recorded so far, overwritten ones included
+	atomic<uint64_t> written {0};
+
+	static uint64_t roundUp(size_t n) {
+		uint64_t p = 1;
+		while(p < n)
+			p <<= 1;
+		return p;
+	}
+};
+
+/*namespace TM end*/}
+
+#endif // EVENTS_H
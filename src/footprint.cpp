@@ -0,0 +1,87 @@
+#include "tmapi.h"
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+/*
+ * Memory taken by variables: creates lots of Variable<int> objects and reports
+ * how much the resident set grew per variable. Everything the TM keeps per
+ * variable counts, i.e. the object itself and any heap blocks it owns.
+ */
+
+// benchmark parameters:
+long long variables;
+
+void setup(int argc, char ** argv);
+
+/// resident set size of the process in bytes (Linux only)
+long long residentBytes(){
+	long long total, resident;
+	ifstream statm("/proc/self/statm");
+	statm >> total >> resident;
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char ** argv){
+	setup(argc, argv);
+
+	vector<Tm::Variable<int>*> vars;
+	vars.reserve(variables);
+
+	long long before = residentBytes();
+	auto start = chrono::steady_clock::now();
+
+	for(long long i = 0 ; i < variables; ++i)
+		vars.push_back(new Tm::Variable<int>(i));
+
+	auto stop = chrono::steady_clock::now();
+	long long after = residentBytes();
+
+	// make sure the variables work at all
+	Tm::beginT();
+	long long sum = vars.front()->ro() + vars.back()->ro();
+	Tm::commitT();
+
+	printf("sizeof(Variable<int>): %8zu B\n", sizeof(Tm::Variable<int>));
+	printf("Resident growth:       %8.1f MB\n", (after - before) / 1048576.0);
+	printf("Per variable:          %8.1f B\n", double(after - before) / variables);
+	printf("Creation:              %8.1f ns/variable\n", chrono::duration<double, nano>(stop-start).count() / variables);
+	printf("(checksum: %lld)\n", sum);
+
+	for(auto v : vars)
+		delete v;
+
+	return 0;
+}
+
+void setup(int argc, char ** argv){
+	boost::program_options::options_description opts;
+	opts.add_options()
+		("variables,n", boost::program_options::value<long long>(&variables)->default_value(10000000), "Number of Variable<int> objects to create")
+		("help,h", "this help")
+	;
+
+	boost::program_options::variables_map vm;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, opts), vm);
+	boost::program_options::notify(vm);
+
+	if (vm.count("help")) {
+		cout << opts << "\n";
+		exit(0);
+	}
+
+	if(variables < 1){
+		printf("Stupid arguments detected. Be gone!\n");
+		exit(1);
+	}
+
+	printf("Variables: %lld\n", variables);
+}
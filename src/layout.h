@@ -0,0 +1,59 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <cstddef>
+
+/**
+ * \file layout.h
+ * \brief Compile-time choice of where the TM keeps its metadata (Orec) and how it is laid out in memory.
+ *
+ * TM_METADATA_PER_VARIABLE - each Variable\<T\> carries its own Orec
+ * TM_METADATA_STRIPED      - variables are mapped by address hash onto a global table of orecStripes Orecs;
+ *                            a variable costs little more than its value, but variables sharing an Orec
+ *                            conflict with each other as if they were one
+ *
+ * TM_LAYOUT_DENSE  - fields packed as tightly as possible (per-variable Variable<int> takes 64 bytes, at any address)
+ * TM_LAYOUT_PADDED - dense, but each Orec starts a cache line, so neighbours never share one
+ * TM_LAYOUT_SPLIT  - fields written on each access (lock, owner, readers) on one line, fields written only
+ *                    by commits (dirty flags and, with per-variable metadata, the value pointer) on the next
+ *
+ * Define TM_METADATA and TM_LAYOUT for the library and for every user of it (CMake options of the same names do so).
+ */
+
+#define TM_METADATA_PER_VARIABLE 0
+#define TM_METADATA_STRIPED      1
+
+#ifndef TM_METADATA
+ #define TM_METADATA TM_METADATA_PER_VARIABLE
+#endif
+
+#if TM_METADATA != TM_METADATA_PER_VARIABLE && TM_METADATA != TM_METADATA_STRIPED
+ #error "TM_METADATA must be TM_METADATA_PER_VARIABLE or TM_METADATA_STRIPED"
+#endif
+
+#define TM_LAYOUT_DENSE  0
+#define TM_LAYOUT_PADDED 1
+#define TM_LAYOUT_SPLIT  2
+
+#ifndef TM_LAYOUT
+ #define TM_LAYOUT TM_LAYOUT_DENSE
+#endif
+
+#if TM_LAYOUT != TM_LAYOUT_DENSE && TM_LAYOUT != TM_LAYOUT_PADDED && TM_LAYOUT != TM_LAYOUT_SPLIT
+ #error "TM_LAYOUT must be TM_LAYOUT_DENSE, TM_LAYOUT_PADDED or TM_LAYOUT_SPLIT"
+#endif
+
+namespace Tm {
+
+/// assumed size of a cache line
+const size_t cacheLineSize = 64;
+
+/*namespace TM end*/}
+
+#if TM_LAYOUT == TM_LAYOUT_DENSE
+ #define TM_OREC_ALIGNMENT
+#else
+ #define TM_OREC_ALIGNMENT alignas(Tm::cacheLineSize)
+#endif
+
+#endif // LAYOUT_H
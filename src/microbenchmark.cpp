@@ -4,45 +4,297 @@
 #include <functional>
 #include <atomic>
 #include <random>
-#include <list>
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <set>
+#include <memory>
 
-#include <boost/program_options.hpp>
+#include "driver.h"
+#include "distribution.h"
+#include "txtrace.h"
 
-// C++11 has no thread interrupt at all :(
-#include <boost/thread.hpp>
-// but at least I don't have to implement barriers
-#include <boost/thread/barrier.hpp>
-#include <boost/chrono.hpp>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
+/// threads, windows, output (see driver.h)
+Bench::Driver driver("microbench");
+
 // benchmark parameters:
-int threadNo;
-int timeSecs;
 int varsNo;
 int transfersPerTransaction;
 int readsPerTransaction;
 int selfAbortThreshold;
 
-thread_local default_random_engine generator(boost::chrono::high_resolution_clock::now().time_since_epoch().count());
+/// how aborts reach the benchmark
+enum class Api {exceptions, status, atomically} api;
+
+/// which variables transfers and reads pick
+Bench::Distribution transferDist;
+Bench::Distribution readDist;
+
+/// begin all transactions as ReadOnly (transfers turn them into ordinary ones)
+bool readOnlyMode;
+
+/// retry policy from the library; nullptr stands for the sleep-based restartPolicy below
+Tm::ContentionManager * contentionManager = nullptr;
+
+/// heap allocations done so far by this thread, counted by the operator new below
+thread_local long long allocations = 0;
+
+/// if the last attempt of a transaction in this thread was irrevocable when it committed (or gave up)
+thread_local bool attemptIrr = false;
+
+typedef chrono::steady_clock Clock;
+
+uint64_t nsSince(Clock::time_point start) {
+	return chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// not inlined, so that the compiler does not pair malloc / free with new / delete expressions
+
+[[gnu::noinline]] void * operator new(size_t size) {
+	++allocations;
+	if(void * p = malloc(size ? size : 1))
+		return p;
+	throw bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void * p) noexcept {
+	free(p);
+}
+
+[[gnu::noinline]] void operator delete(void * p, size_t) noexcept {
+	free(p);
+}
+
+/**
+ * HDR-style latency histogram: each power of two is split into 32 buckets, so that any value
+ * is recorded with at most ~3% error, from nanoseconds to hours, in 15 KB.
+ * One per thread and kind of latency, so no locks; merged with += at the end.
+ */
+class LatencyHistogram {
+public:
+	void record(uint64_t ns) {
+		counts[bucketOf(ns)]++;
+		total++;
+		maxNs = max(maxNs, ns);
+	}
+	
+	LatencyHistogram & operator += (const LatencyHistogram & other) {
+		for(unsigned i = 0 ; i < buckets; ++i)
+			counts[i] += other.counts[i];
+		total += other.total;
+		maxNs = max(maxNs, other.maxNs);
+		return *this;
+	}
+	
+	uint64_t count() const {return total;}
+	uint64_t maximum() const {return maxNs;}
+	
+	/// \returns value below which fraction q of the recorded values lie (the middle of its bucket, but never above the maximum)
+	double percentile(double q) const {
+		uint64_t rank = (uint64_t) ceil(q * total), seen = 0;
+		for(unsigned i = 0 ; i < buckets; ++i){
+			seen += counts[i];
+			if(seen >= rank && counts[i])
+				return min(lowestOf(i) + (lowestOf(i+1) - lowestOf(i)) / 2.0, double(maxNs));
+		}
+		return maxNs;
+	}
+	
+private:
+	static const unsigned subBits = 5;
+	static const unsigned buckets = (64 - subBits + 1) << subBits;
+	
+	/// values below 32 get a bucket each; above, bucket = (exponent - 4, 5 bits after the leading one)
+	static unsigned bucketOf(uint64_t v) {
+		if(v < (1u << subBits))
+			return v;
+		unsigned e = 63 - __builtin_clzll(v);
+		return ((e - subBits + 1) << subBits) + ((v >> (e - subBits)) & ((1u << subBits) - 1));
+	}
+	
+	static double lowestOf(unsigned bucket) {
+		unsigned group = bucket >> subBits, sub = bucket & ((1u << subBits) - 1);
+		if(!group)
+			return sub;
+		return ldexp((1u << subBits) + sub, group - 1);
+	}
+	
+	vector<uint64_t> counts = vector<uint64_t>(buckets);
+	uint64_t total = 0;
+	uint64_t maxNs = 0;
+};
 
 struct stats {
 	int successfull = 0;
 	int aborted = 0;
 	int selfAborted = 0;
+	/// allocations done inside transactions (workload generation excluded)
+	long long allocations = 0;
+	/// commit calls timed with --commit-latency and the time they took
+	long long commits = 0;
+	double commitNs = 0;
+	/// whole transactions (from the first attempt to the commit, retries and backoff included) and single attempts,
+	/// each split into [0] those that did not end irrevocable and [1] those that did
+	LatencyHistogram transactionLatency[2];
+	LatencyHistogram attemptLatency[2];
+	/// committed scans of the scan workload, and those that saw a wrong total
+	int scans = 0;
+	int tornScans = 0;
 	
 	stats & operator += (const stats & other) {
 		successfull += other.successfull;
 		aborted += other.aborted;
 		selfAborted += other.selfAborted;
+		allocations += other.allocations;
+		commits += other.commits;
+		commitNs += other.commitNs;
+		for(int irr = 0 ; irr < 2; ++irr){
+			transactionLatency[irr] += other.transactionLatency[irr];
+			attemptLatency[irr] += other.attemptLatency[irr];
+		}
+		scans += other.scans;
+		tornScans += other.tornScans;
 		return *this;
 	}
 };
 
+/// time commits (costs two clock reads per commit)
+bool measureCommits;
+
+/// file to write the TM statistics to (as CSV), none if empty
+string statsFile;
+
+/// file to dump TM events to (Chrome trace JSON), none if empty
+string eventsFile;
+
+/// how many of the variables that cost the most transactions to print, none if 0
+int conflictsTop;
+
+/// adds the time from its construction to its destruction to commit stats, if measureCommits is on
+struct CommitTimer {
+	stats & s;
+	Clock::time_point start;
+	
+	CommitTimer(stats & s) : s(s) {
+		if(measureCommits)
+			start = Clock::now();
+	}
+	
+	~CommitTimer() {
+		if(!measureCommits)
+			return;
+		s.commits++;
+		s.commitNs += chrono::duration<double, nano>(Clock::now() - start).count();
+	}
+};
+
+/// random state of one thread generating its transactions
+struct Generator {
+	default_random_engine engine;
+	Bench::Distribution::Picker transfers;
+	Bench::Distribution::Picker reads;
+	
+	explicit Generator(int thread) : engine(driver.seedFor(thread)), transfers(transferDist, thread), reads(readDist, thread) {}
+};
+
+/**
+ * \brief A scenario microbench can run: the transactions the workers keep running on the accounts
+ * 
+ * Transactions are generated up front into a Bench::TxTrace (or replayed from a file), so that the timed
+ * run spends nothing on making them up. All of them keep the sum of the accounts, which finalChecks verifies.
+ */
+class Workload {
+public:
+	virtual ~Workload() {}
+	
+	/// \returns false if the options do not fit the workload
+	virtual bool setup() {return true;}
+	
+	/// appends the record of the next transaction of thread to words
+	virtual void generate(int thread, Generator & g, vector<uint32_t> & words) = 0;
+	
+	/// runs transaction tx in the calling worker (retries included) and records it in threadStats
+	virtual void transaction(stats & threadStats, const Bench::TxRecord & tx) = 0;
+};
+
+/// transfers plus reads, 1 in 25 transactions going irrevocable somewhere in the middle; runs with any --api
+class Bank : public Workload {
+public:
+	void generate(int thread, Generator & g, vector<uint32_t> & words) override;
+	void transaction(stats & threadStats, const Bench::TxRecord & tx) override;
+};
+
+/// transactions that read --reads accounts; --updates percent of them also do the transfers
+class Lookup : public Workload {
+public:
+	void generate(int thread, Generator & g, vector<uint32_t> & words) override;
+	void transaction(stats & threadStats, const Bench::TxRecord & tx) override;
+};
+
+/// --scanners workers keep reading all accounts (checking the sum); the others keep doing the transfers
+class Scan : public Workload {
+public:
+	bool setup() override;
+	void generate(int thread, Generator & g, vector<uint32_t> & words) override;
+	void transaction(stats & threadStats, const Bench::TxRecord & tx) override;
+};
+
+/// --io-threads workers do the transfers irrevocably and log them to --io-file; the others do transfers and reads revocably
+class IrrevocableIo : public Workload {
+public:
+	bool setup() override;
+	void generate(int thread, Generator & g, vector<uint32_t> & words) override;
+	void transaction(stats & threadStats, const Bench::TxRecord & tx) override;
+	
+private:
+	/// closes the log, reporting a failure (e.g. of flushing it)
+	struct FileCloser {
+		void operator () (FILE * f) const;
+	};
+	
+	unique_ptr<FILE, FileCloser> file;
+	int fd = -1;
+};
+
+string workloadName;
+
+/// percent of Lookup transactions that write
+int updatePercent;
+/// workers running scans in Scan, and irrevocable ones in IrrevocableIo
+int scanners;
+int ioThreads;
+/// where IrrevocableIo logs; an unlinked temporary file if empty
+string ioFile;
+
+/// the one being run; declared after the options, so that it is destroyed before them
+unique_ptr<Workload> workload;
+
+/// transactions of all threads, generated or replayed
+Bench::TxTrace trace;
+/// transactions generated per thread (each thread goes round and round its own)
+int pregenerated;
+/// where to save the generated transactions, and where to take them from instead of generating them
+string recordFile;
+string replayFile;
+
 void setup(int argc, char ** argv);
-void threadFunc(stats & threadStats, boost::barrier * b);
-void printStats(stats & s);
-void makeSomeTransaction(stats & threadStats);
+Bench::Metrics metrics(const stats & s, double seconds, const Bench::PerfCounts & events);
+void printStats(stats & s, double seconds);
+void printTmStats(const Tm::Stats & s);
+void exportTmStats(const Tm::Stats & s);
+void printConflicts(const vector<Tm::VariableConflicts> & hot);
+void makeSomeTransaction(stats & threadStats, const Bench::TxRecord & tx);
+void generateTrace();
 void initVars();
 void finalChecks();
 void freeVars();
@@ -51,111 +303,270 @@ int main(int argc, char ** argv){
 	
 	setup(argc, argv);
 	
-	vector<boost::thread> threads;
-	vector<stats> threadStats(threadNo);
-	
-	boost::barrier threadBarrier(threadNo+1);
-	
-	for(int i = 0 ; i < threadNo; ++i){
-		threads.push_back(boost::thread(threadFunc, ref(threadStats[i]), &threadBarrier));
-	}
-	
-	auto sleepTime = boost::chrono::seconds(timeSecs);
-	   threadBarrier.wait();
-	boost::this_thread::sleep_for(sleepTime);
-	for(boost::thread & t: threads)
-		t.interrupt();
-	for(boost::thread & t: threads)
-		t.join();
-	
-	atomic_thread_fence(memory_order_seq_cst);
-	
+	// TM statistics and conflicts cover the measured windows only
+	Bench::Outcome<stats> outcome = driver.run<stats>("", [](stats & s){
+		thread_local Bench::TxCursor cursor(trace, Bench::threadIndex());
+		workload->transaction(s, cursor.next());
+	}, metrics, [](){
+		Tm::resetStats();
+		Tm::resetConflicts();
+	});
 	
-	stats finalStats;
-	for(int i = 0 ; i < threadNo; ++i)
-		finalStats += threadStats[i];
+	// before finalChecks adds its own transaction
+	Tm::Stats tmStats = Tm::stats();
+	vector<Tm::VariableConflicts> hot;
+	if(conflictsTop)
+		hot = Tm::conflictHotspots(conflictsTop);
 	
+	if(outcome.total.tornScans)
+		printf("TM problem - %d committed scans saw a wrong sum\n", outcome.total.tornScans);
 	finalChecks();
 	
-	printStats(finalStats);
+	printStats(outcome.total, outcome.seconds);
+	printTmStats(tmStats);
+	if(!statsFile.empty())
+		exportTmStats(tmStats);
+	if(conflictsTop)
+		printConflicts(hot);
+	if(!eventsFile.empty() && !Tm::dumpEvents(eventsFile))
+		printf("Cannot write TM events to %s (they are recorded only if the TM is built with -DTM_EVENTS=ON)\n", eventsFile.c_str());
+	driver.finish();
 	
 	freeVars();
 	
-	#ifdef TRACK_ABORTS
-	printAbortSources();
-	#endif
 	return 0;
 }
 
 void setup(int argc, char ** argv){
-	boost::program_options::options_description opts;
-	opts.add_options()
-		("threads,t", boost::program_options::value<int>(&threadNo)->default_value( 2), "Thread number")
-		("seconds,s", boost::program_options::value<int>(&timeSecs)->default_value( 1), "Benchmark length in seconds")
-		("vars,v", boost::program_options::value<int>(&varsNo)->default_value(1024), "Number of variables")
-		("transfers,w", boost::program_options::value<int>(&transfersPerTransaction)->default_value(10), "Transfers per transaction (1 × read + 2 × write)")
-		("reads,r", boost::program_options::value<int>(&readsPerTransaction)->default_value(70), "Reads per transaction")
-		("selfabort_thr,a", boost::program_options::value<int>(&selfAbortThreshold)->default_value(5), "Failed transfer per transaction to self abort")
-		("help,h", "this help")
-	;
-	
-	boost::program_options::variables_map vm;
-	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, opts), vm);
-	boost::program_options::notify(vm);
-	
-	if (vm.count("help")) {
-		cout << opts << "\n";
-		exit(0);
-	}
-	
-	if(varsNo < 2 || threadNo < 1 || timeSecs < 1 || transfersPerTransaction < 0 || readsPerTransaction < 0 
+	string apiName;
+	string cmName;
+	string transferDistName;
+	string readDistName;
+	Bench::Options opts;
+	driver.addOptions(opts);
+	opts.add("vars", 'v', varsNo, 1024, "Number of variables")
+	    .add("transfers", 'w', transfersPerTransaction, 10, "Transfers per transaction (1 × read + 2 × write)")
+	    .add("reads", 'r', readsPerTransaction, 70, "Reads per transaction")
+	    .add("dist", 'd', transferDistName, "uniform", "Variables transfers pick: uniform, zipf:θ (0 ≤ θ < 1), hotspot:x:y (x% of accesses to y% of variables), partitioned or sequential (own n/threads variables per thread)")
+	    .add("read-dist", 'D', readDistName, "", "Variables reads pick, as in --dist; same as --dist if not given")
+	    .add("selfabort_thr", 'a', selfAbortThreshold, 5, "Failed transfer per transaction to self abort")
+	    .add("api", 'A', apiName, "exceptions", "How aborts are reported: exceptions, status (tryRo/tryRw/tryCommitT) or atomically (status API run by Tm::atomically)")
+	    .addSwitch("readonly", 'o', readOnlyMode, "Begin transactions as ReadOnly; best with -w 0")
+	    .addSwitch("commit-latency", 'L', measureCommits, "Measure how long commits take (not with -A atomically)")
+	    .add("stats", 'S', statsFile, "", "Write TM statistics (Tm::stats()) as CSV to this file")
+	    .add("conflicts", 0, conflictsTop, 0, "Print the N variables that cost the most transactions, and who lost to whom over them (Tm::conflictHotspots()); needs a TM built with -DTM_CONFLICTS=ON")
+	    .add("events", 0, eventsFile, "", "Dump the latest TM events of each thread (Tm::dumpEvents()) as a Chrome trace to this file; needs a TM built with -DTM_EVENTS=ON")
+	    .add("workload", 'k', workloadName, "bank", "What transactions do: bank (transfers and reads, some irrevocable), lookup (reads, --updates % also transfer), scan (--scanners threads read all variables, the others transfer) or irrio (--io-threads threads transfer irrevocably and write to --io-file, the others transfer and read); all but bank run through Tm::atomically")
+	    .add("updates", 'u', updatePercent, 10, "lookup: percent of transactions that also do the transfers")
+	    .add("scanners", 0, scanners, 1, "scan: threads that scan")
+	    .add("io-threads", 0, ioThreads, 1, "irrio: threads doing irrevocable transactions with I/O")
+	    .add("io-file", 0, ioFile, "", "irrio: file (or named pipe) written by irrevocable transactions; a temporary file if not given")
+	    .add("pregenerate", 'g', pregenerated, 10000, "Transactions generated per thread before the run; each thread repeats its own")
+	    .add("record", 0, recordFile, "", "Save the generated transactions to this file")
+	    .add("replay", 0, replayFile, "", "Run the transactions saved by --record instead of generating them (takes variables and seed from the file)")
+	    .add("cm", 'C', cmName, "legacy", "Retry policy: legacy (sleep, every other retry irrevocable), none (retry at once), backoff, irrevocable (backoff, 8th retry irrevocable) or timestamp (oldest first)");
+	opts.parse(argc, argv);
+	
+	if(!driver.setup(opts) || varsNo < 2 || transfersPerTransaction < 0 || readsPerTransaction < 0 
 		|| transfersPerTransaction + readsPerTransaction < 1 || selfAbortThreshold < 0 || readsPerTransaction > varsNo){
 		printf("Stupid arguments detected. Be gone!\n");
 		exit(1);
 	}
 	
+	if(workloadName == "bank")
+		workload.reset(new Bank());
+	else if(workloadName == "lookup")
+		workload.reset(new Lookup());
+	else if(workloadName == "scan")
+		workload.reset(new Scan());
+	else if(workloadName == "irrio")
+		workload.reset(new IrrevocableIo());
+	else {
+		printf("Unknown workload: %s\n", workloadName.c_str());
+		exit(1);
+	}
+	
+	if(!replayFile.empty()){
+		if(!trace.load(replayFile))
+			exit(1);
+		if(trace.workload() != workloadName){
+			printf("%s holds transactions of workload %s, not %s\n", replayFile.c_str(), trace.workload().c_str(), workloadName.c_str());
+			exit(1);
+		}
+		varsNo = trace.vars();
+		driver.seed = trace.seed();
+	}
+	
+	if(!workload->setup() || updatePercent < 0 || updatePercent > 100 || pregenerated < 1){
+		printf("Stupid arguments detected. Be gone!\n");
+		exit(1);
+	}
+	
+	if(readDistName.empty())
+		readDistName = transferDistName;
+	// the same seed gives both the same permutation, so that hot variables are the same for reads and transfers
+	if(!transferDist.setup(transferDistName, varsNo, driver.threads, driver.seed) || !readDist.setup(readDistName, varsNo, driver.threads, driver.seed)
+		|| (transfersPerTransaction && transferDist.reach() < 2) || readDist.reach() < readsPerTransaction){
+		printf("Stupid arguments detected. Be gone!\n");
+		exit(1);
+	}
+	
+	if(apiName == "exceptions")
+		api = Api::exceptions;
+	else if(apiName == "status")
+		api = Api::status;
+	else if(apiName == "atomically")
+		api = Api::atomically;
+	else {
+		printf("Unknown API: %s\n", apiName.c_str());
+		exit(1);
+	}
+	
+	if(cmName == "none")
+		contentionManager = new Tm::ContentionManager();
+	else if(cmName == "backoff")
+		contentionManager = new Tm::ExponentialBackoff();
+	else if(cmName == "irrevocable")
+		contentionManager = new Tm::IrrevocableAfter();
+	else if(cmName == "timestamp")
+		contentionManager = new Tm::TimestampPriority();
+	else if(cmName != "legacy") {
+		printf("Unknown retry policy: %s\n", cmName.c_str());
+		exit(1);
+	}
+	
 	initVars();
+	generateTrace();
 	
-	printf("Threads: %d\nSeconds: %d\nVars: %d\nTransfers/transaction %d\nReads/transaction %d\nFailedTransfersForSelfAbort %d\n",
-		       threadNo,    timeSecs,   varsNo,  transfersPerTransaction,  readsPerTransaction,             selfAbortThreshold);
+	printf("Threads: %d\nSeconds: %g × %d (after %g s warmup)\nVars: %d\nTransfers/transaction %d\nReads/transaction %d\nFailedTransfersForSelfAbort %d\nAPI: %s\nRetry policy: %s\nReadOnly: %s\nDistribution: %s (transfers), %s (reads)\nWorkload: %s\n",
+		       driver.threads, driver.seconds, driver.repetitions, driver.warmupSecs, varsNo,  transfersPerTransaction,  readsPerTransaction,             selfAbortThreshold,          apiName.c_str(),  cmName.c_str(),  readOnlyMode ? "yes" : "no", transferDist.name().c_str(), readDist.name().c_str(), workloadName.c_str());
+	if(replayFile.empty())
+		printf("Transactions: %d per thread, generated\n", pregenerated);
+	else
+		printf("Transactions: replayed from %s (%d threads)\n", replayFile.c_str(), trace.threads());
+}
+
+Bench::Metrics metrics(const stats & s, double seconds, const Bench::PerfCounts & events){
+	LatencyHistogram latency = s.transactionLatency[0];
+	latency += s.transactionLatency[1];
+	Bench::Metrics m {
+		{"commits/s", s.successfull / seconds},
+		{"aborts/s", s.aborted / seconds},
+		{"selfAborts/s", s.selfAborted / seconds},
+		{"tx p50 [us]", latency.count() ? latency.percentile(0.5) / 1000 : 0},
+		{"tx p99 [us]", latency.count() ? latency.percentile(0.99) / 1000 : 0},
+	};
+	if(workloadName == "scan")
+		m.push_back(make_pair("scans/s", s.scans / seconds));
+	if(workloadName == "irrio"){
+		const LatencyHistogram & irr = s.transactionLatency[1];
+		m.push_back(make_pair("irr. tx/s", irr.count() / seconds));
+		m.push_back(make_pair("irr. tx p99 [us]", irr.count() ? irr.percentile(0.99) / 1000 : 0));
+	}
+	events.normalized(m, "commit", s.successfull);
+	events.normalized(m, "attempt", s.successfull + s.aborted + s.selfAborted);
+	return m;
 }
 
-void threadFunc(stats & threadStats, boost::barrier * b){
-	b->wait();
+void printStats(stats& s, double seconds){
+	printf("Successfull: %d tx total, %f tx/s\n", s.successfull, s.successfull/seconds);
+	printf("Aborted: %d tx total, %f tx/s\n", s.aborted, s.aborted/seconds); 
+	printf("SelfAborted: %d tx total, %f tx/s\n", s.selfAborted, s.selfAborted/seconds); 
+	int attempts = s.successfull + s.aborted + s.selfAborted;
+	printf("Allocations: %lld total, %f per attempt, %f per successfull tx\n", s.allocations,
+	       attempts ? s.allocations/double(attempts) : 0., s.successfull ? s.allocations/double(s.successfull) : 0.);
+	if(s.commits)
+		printf("Commit latency: %.1f ns avg over %lld commits\n", s.commitNs/s.commits, s.commits);
 	
-	while(true){
-		makeSomeTransaction(threadStats);
-		boost::this_thread::interruption_point();
+	printf("Latency [us]              count        p50        p99      p99.9        max\n");
+	const char * names[2][2] = {{"tx, revocable", "tx, irrevocable"}, {"attempt, revocable", "attempt, irrevocable"}};
+	for(int kind = 0 ; kind < 2; ++kind)
+		for(int irr = 0 ; irr < 2; ++irr){
+			const LatencyHistogram & h = kind ? s.attemptLatency[irr] : s.transactionLatency[irr];
+			if(!h.count())
+				continue;
+			printf("%-22s %10llu %10.1f %10.1f %10.1f %10.1f\n", names[kind][irr], (unsigned long long) h.count(),
+			       h.percentile(0.5)/1000, h.percentile(0.99)/1000, h.percentile(0.999)/1000, h.maximum()/1000.0);
+		}
+}
+
+void printTmStats(const Tm::Stats & s){
+	printf("TM: %llu begins, %llu commits, %llu aborts\n", (unsigned long long) s.begins, (unsigned long long) s.commits, (unsigned long long) s.aborts);
+	for(unsigned i = 0 ; i < unsigned(Tm::AbortReason::count); ++i)
+		if(s.abortsBy[i])
+			printf("  aborts %-22s %10llu\n", Tm::abortReasonName(Tm::AbortReason(i)), (unsigned long long) s.abortsBy[i]);
+	uint64_t finished = s.commits + s.aborts;
+	if(finished)
+		printf("Read set: %.1f, write set: %.1f entries per finished tx\n", s.readSetEntries/double(finished), s.writeSetEntries/double(finished));
+	printf("Killed readers: %llu, hijacks: %llu\n", (unsigned long long) s.killedReaders, (unsigned long long) s.hijacks);
+	if(s.irrevocable)
+		printf("Irrevocable: %llu tx, wait %.1f us avg, %.1f us max\n", (unsigned long long) s.irrevocable, s.irrWaitNs/1000.0/s.irrevocable, s.irrWaitMaxNs/1000.0);
+}
+
+void printConflicts(const vector<Tm::VariableConflicts> & hot){
+	if(hot.empty()){
+		printf("No conflicts recorded (they are recorded only if the TM is built with -DTM_CONFLICTS=ON)\n");
+		return;
+	}
+	printf("Conflict hotspots            aborts      kills   victim<-culprit slot × transactions\n");
+	for(const Tm::VariableConflicts & v : hot){
+		string who;
+		for(size_t i = 0 ; i < v.pairs.size() && i < 3; ++i){
+			unsigned int culprit = v.pairs[i].first.second;
+			who += (i ? ", " : "") + to_string(v.pairs[i].first.first) + "<-"
+			     + (culprit == Tm::unknownSlot ? string("?") : to_string(culprit)) + " × " + to_string(v.pairs[i].second);
+		}
+		printf("  %-20s %12llu %10llu   %s\n", v.name.empty() ? "?" : v.name.c_str(),
+		       (unsigned long long) v.aborts, (unsigned long long) v.kills, who.c_str());
 	}
 }
 
-void printStats(stats& s){
-	printf("Successfull: %d tx total, %f tx/s\n", s.successfull, s.successfull/double(timeSecs));
-	printf("Aborted: %d tx total, %f tx/s\n", s.aborted, s.aborted/double(timeSecs)); 
-	printf("SelfAborted: %d tx total, %f tx/s\n", s.selfAborted, s.selfAborted/double(timeSecs)); 
+void exportTmStats(const Tm::Stats & s){
+	FILE * f = fopen(statsFile.c_str(), "w");
+	if(!f){
+		perror(statsFile.c_str());
+		return;
+	}
+	fprintf(f, "counter,value\n");
+	fprintf(f, "begins,%llu\n", (unsigned long long) s.begins);
+	fprintf(f, "commits,%llu\n", (unsigned long long) s.commits);
+	fprintf(f, "aborts,%llu\n", (unsigned long long) s.aborts);
+	for(unsigned i = 0 ; i < unsigned(Tm::AbortReason::count); ++i)
+		fprintf(f, "aborts.%s,%llu\n", Tm::abortReasonName(Tm::AbortReason(i)), (unsigned long long) s.abortsBy[i]);
+	fprintf(f, "irrevocable,%llu\n", (unsigned long long) s.irrevocable);
+	fprintf(f, "irrWaitNs,%llu\n", (unsigned long long) s.irrWaitNs);
+	fprintf(f, "irrWaitMaxNs,%llu\n", (unsigned long long) s.irrWaitMaxNs);
+	fprintf(f, "hijacks,%llu\n", (unsigned long long) s.hijacks);
+	fprintf(f, "readSetEntries,%llu\n", (unsigned long long) s.readSetEntries);
+	fprintf(f, "writeSetEntries,%llu\n", (unsigned long long) s.writeSetEntries);
+	fprintf(f, "killedReaders,%llu\n", (unsigned long long) s.killedReaders);
+	fclose(f);
 }
 
 //////////////////////////////
 //////////////////////////////
 
-typedef tuple<Tm::Variable<int>*, Tm::Variable<int>*, int> transferDescr;
-
 vector<Tm::Variable<int>*> vars;
 int varsSum = 0;
 
 enum TransResult {Success, Abort, SelfAbort};
 
-TransResult runTransaction(list<transferDescr>& todo, vector<Tm::Variable<int>*>& reads, bool shallBecomeIrr, int whenIrr, stats & threadStats);
+TransResult runTransaction(const Bench::TxRecord & tx, bool shallBecomeIrr, int whenIrr, stats & threadStats);
+TransResult runTransactionStatus(const Bench::TxRecord & tx, bool shallBecomeIrr, int whenIrr, stats & threadStats);
+void runAtomically(const Bench::TxRecord & tx, stats & threadStats, Clock::time_point transactionStart);
 inline void restartPolicy(int restartNo, bool & shallBecomeIrr, int & whenIrr, const bool & shallBecomeIrr_o, const int & whenIrr_o);
 
 
 void initVars(){
+	default_random_engine generator(driver.seedFor(-1));
 	normal_distribution<> startDist(100, 33);
 	for(int i=0; i < varsNo; ++i){
 		int amount = startDist(generator);
 		if(amount<0)amount=0;
 		vars.push_back(new Tm::Variable<int>(amount));
 		varsSum+=amount;
+		if(conflictsTop)
+			Tm::nameVariable(*vars.back(), "var " + to_string(i));
 	}
 }
 
@@ -166,72 +577,129 @@ void freeVars()
 	vars.clear();
 }
 
-list<transferDescr> generateTransfers() {
-	list<transferDescr> result;
-	
-	thread_local static uniform_int_distribution<> varDist(0, varsNo-1);
-	thread_local static uniform_int_distribution<> amountDist(1, 25);
+/// appends count transfers (from, to, amount) to words
+void generateTransfers(Generator & g, vector<uint32_t> & words, int count) {
+	uniform_int_distribution<> amountDist(1, 25);
+	bernoulli_distribution swapDist;
 	
-	for(int i = 0 ; i < transfersPerTransaction; ++i){
-		int a = varDist(generator), b;
+	for(int i = 0 ; i < count; ++i){
+		int a = g.transfers.next(g.engine), b;
 		// roll b until a!=b
-		while(a == (b = varDist(generator)));
-		result.push_back(transferDescr(vars[a], vars[b], amountDist(generator)));
+		while(a == (b = g.transfers.next(g.engine)));
+		// a sequential walk would always move money the same way round and drain half of the accounts
+		if(swapDist(g.engine))
+			swap(a, b);
+		words.push_back(a);
+		words.push_back(b);
+		words.push_back(amountDist(g.engine));
 	}
-	
-	return result;
 }
 
-vector<Tm::Variable<int>*> generateReads(){
-	thread_local static uniform_int_distribution<> varDist(0, varsNo-1);
-	
+/// appends count distinct variables to read, in random order, to words
+void generateReads(Generator & g, vector<uint32_t> & words, int count){
 	set<int> varNums;
-	while((int)varNums.size()!=readsPerTransaction)
-		      varNums.insert(varDist(generator));
+	while((int)varNums.size()!=count)
+		      varNums.insert(g.reads.next(g.engine));
 	
-	vector<Tm::Variable<int>*> result;
+	vector<uint32_t> result(varNums.begin(), varNums.end());
+	shuffle(result.begin(), result.end(), g.engine);
+	words.insert(words.end(), result.begin(), result.end());
+}
+
+/// fills trace with pregenerated transactions of each thread, unless it was replayed from a file
+void generateTrace(){
+	if(!replayFile.empty())
+		return;
 	
-	for(int varnum : varNums)
-		result.push_back(vars[varnum]);
+	trace.create(driver.threads, workloadName, varsNo, driver.seed);
+	for(int t = 0 ; t < driver.threads; ++t){
+		Generator g(t);
+		for(int i = 0 ; i < pregenerated; ++i)
+			workload->generate(t, g, trace.stream(t));
+	}
 	
-	shuffle(result.begin(), result.end(), generator);
+	if(!recordFile.empty() && !trace.save(recordFile))
+		exit(1);
+}
+
+void Bank::generate(int, Generator & g, vector<uint32_t> & words){
+	// 1 in 25 trans. is irrevoc.
+	uniform_int_distribution<> shallBecomeIrrDist(0, 24);
+	bool shallBecomeIrr = !shallBecomeIrrDist(g.engine);
+	uniform_int_distribution<> whenIrrDist(0, transfersPerTransaction+1);
+	int whenIrr = shallBecomeIrr ? whenIrrDist(g.engine) : -1;
 	
-	return result;
+	Bench::TxRecord::append(words, transfersPerTransaction, readsPerTransaction, whenIrr);
+	generateTransfers(g, words, transfersPerTransaction);
+	generateReads(g, words, readsPerTransaction);
 }
 
-void makeSomeTransaction(stats & threadStats){
-	list<transferDescr> transfers = generateTransfers();
-	vector<Tm::Variable<int>*> reads = generateReads();
+void Bank::transaction(stats & threadStats, const Bench::TxRecord & tx) {
+	makeSomeTransaction(threadStats, tx);
+}
+
+void makeSomeTransaction(stats & threadStats, const Bench::TxRecord & tx){
+	bool shallBecomeIrr = tx.irrAt() >= 0;
+	int whenIrr = shallBecomeIrr ? tx.irrAt() : 0;
 	
-	// 1 in 25 trans. is irrevoc.
-	thread_local static uniform_int_distribution<> shallBecomeIrrDist(0, 24);
-	bool shallBecomeIrr = !shallBecomeIrrDist(generator);
-	thread_local static uniform_int_distribution<> whenIrrDist(0, transfersPerTransaction+1);
-	int whenIrr = shallBecomeIrr ? whenIrrDist(generator) : 0;
+	Clock::time_point transactionStart = Clock::now();
+	
+	if(api == Api::atomically){
+		runAtomically(tx, threadStats, transactionStart);
+		return;
+	}
 	
 	int restartNo=0;
 	bool shallBecomeIrr_o = shallBecomeIrr;
 	int whenIrr_o = whenIrr;
 	
+	Tm::AbortHistory & history = Tm::abortHistory();
+	history.newTransaction();
+	
 	while(1){
-		TransResult res = runTransaction(transfers, reads, shallBecomeIrr, whenIrr, threadStats);
+		if(contentionManager){
+			bool irrFromStart = contentionManager->beforeAttempt(history);
+			shallBecomeIrr = irrFromStart || shallBecomeIrr_o;
+			whenIrr = irrFromStart ? 0 : whenIrr_o;
+		}
+		
+		long long allocationsBefore = allocations;
+		Clock::time_point attemptStart = Clock::now();
+		attemptIrr = false;
+		TransResult res = api == Api::status
+		                ? runTransactionStatus(tx, shallBecomeIrr, whenIrr, threadStats)
+		                : runTransaction(tx, shallBecomeIrr, whenIrr, threadStats);
+		threadStats.attemptLatency[attemptIrr].record(nsSince(attemptStart));
+		threadStats.allocations += allocations - allocationsBefore;
 		switch(res){
 			case TransResult::Success:
 				threadStats.successfull++;
+				threadStats.transactionLatency[attemptIrr].record(nsSince(transactionStart));
+				if(contentionManager){
+					history.recordCommit();
+					contentionManager->afterCommit(history);
+				}
 				return;
 			case TransResult::Abort:
 				threadStats.aborted++;
-				restartPolicy(restartNo, shallBecomeIrr, whenIrr, shallBecomeIrr_o, whenIrr_o);
+				if(contentionManager){
+					history.recordAbort();
+					contentionManager->afterAbort(history);
+				} else {
+					restartPolicy(restartNo, shallBecomeIrr, whenIrr, shallBecomeIrr_o, whenIrr_o);
+				}
 				break;
 			case TransResult::SelfAbort:
 				threadStats.selfAborted++;
+				if(contentionManager)
+					contentionManager->afterGiveUp(history);
 				return;
 		}
 	}
 }
 
 inline void restartPolicy(int restartNo, bool & shallBecomeIrr, int & whenIrr, const bool & shallBecomeIrr_o, const int & whenIrr_o) {
-	boost::this_thread::sleep_for(boost::chrono::nanoseconds(100000)*restartNo + boost::chrono::nanoseconds(100000));
+	this_thread::sleep_for(chrono::nanoseconds(100000)*restartNo + chrono::nanoseconds(100000));
 	if(restartNo++%2){
 		shallBecomeIrr = true;
 		whenIrr = 0;
@@ -243,32 +711,32 @@ inline void restartPolicy(int restartNo, bool & shallBecomeIrr, int & whenIrr, c
 
 class SelfAbortEx{};
 
-TransResult runTransaction(list<transferDescr>& todo, vector<Tm::Variable<int>*>& reads, bool shallBecomeIrr, int whenIrr, stats & threadStats) {
+TransResult runTransaction(const Bench::TxRecord & tx, bool shallBecomeIrr, int whenIrr, stats & threadStats) {
 	try{
 		bool isIrr = false;
 		int failedCnt = 0;
 		
-		int readsPerTransfer = readsPerTransaction/(transfersPerTransaction>0?transfersPerTransaction:1);
-		auto readIt =  reads.begin();
+		uint32_t readsPerTransfer = tx.reads()/(tx.transfers()>0?tx.transfers():1);
+		uint32_t readIt = 0;
 		[[gnu::unused]] volatile int lastRead;
 		
-		Tm::beginT();
+		Tm::beginT(readOnlyMode ? Tm::ReadOnly : Tm::ReadWrite);
 		
 		int i = 0;
-		for(transferDescr & d : todo) {
+		for(uint32_t t = 0 ; t < tx.transfers(); ++t) {
 			if(shallBecomeIrr && i++ == whenIrr) {
 				Tm::irrT();
 				isIrr = true;
 			}
 			
-			for (int r=0; r < readsPerTransfer; ++r){
-				lastRead = (*readIt)->ro();
+			for (uint32_t r=0; r < readsPerTransfer; ++r){
+				lastRead = vars[tx.read(readIt)]->ro();
 				++readIt;
 			}
 			
-			Tm::Variable<int> * from   = get<0>(d);
-			Tm::Variable<int> * to     = get<1>(d);
-			int                 amount = get<2>(d);
+			Tm::Variable<int> * from   = vars[tx.from(t)];
+			Tm::Variable<int> * to     = vars[tx.to(t)];
+			int                 amount = tx.amount(t);
 			
 			if(from->ro() < amount){
 				failedCnt++;
@@ -284,14 +752,16 @@ TransResult runTransaction(list<transferDescr>& todo, vector<Tm::Variable<int>*>
 			to->rw()+=amount;
 		}
 		
-		while(readIt!=reads.end()){
-			lastRead = (*readIt)->ro();
+		while(readIt!=tx.reads()){
+			lastRead = vars[tx.read(readIt)]->ro();
 			++readIt;
 		}
 		
 		if(shallBecomeIrr && i == whenIrr)
 			Tm::irrT();
 		
+		attemptIrr = Tm::irrevocableT();
+		CommitTimer timer(threadStats);
 		Tm::commitT();
 	} catch(const SelfAbortEx & sa) {
 		return TransResult::SelfAbort;
@@ -303,6 +773,278 @@ TransResult runTransaction(list<transferDescr>& todo, vector<Tm::Variable<int>*>
 	return TransResult::Success;
 }
 
+/// same as runTransaction, but aborts come as return values instead of exceptions
+TransResult runTransactionStatus(const Bench::TxRecord & tx, bool shallBecomeIrr, int whenIrr, stats & threadStats) {
+	bool isIrr = false;
+	int failedCnt = 0;
+	
+	uint32_t readsPerTransfer = tx.reads()/(tx.transfers()>0?tx.transfers():1);
+	uint32_t readIt = 0;
+	[[gnu::unused]] volatile int lastRead;
+	
+	Tm::beginT(readOnlyMode ? Tm::ReadOnly : Tm::ReadWrite);
+	
+	int i = 0;
+	for(uint32_t t = 0 ; t < tx.transfers(); ++t) {
+		if(shallBecomeIrr && i++ == whenIrr) {
+			if(Tm::tryIrrT() != Tm::TxStatus::ok)
+				return TransResult::Abort;
+			isIrr = true;
+		}
+		
+		for (uint32_t r=0; r < readsPerTransfer; ++r){
+			const int * val = vars[tx.read(readIt)]->tryRo();
+			if(!val)
+				return TransResult::Abort;
+			lastRead = *val;
+			++readIt;
+		}
+		
+		Tm::Variable<int> * from   = vars[tx.from(t)];
+		Tm::Variable<int> * to     = vars[tx.to(t)];
+		int                 amount = tx.amount(t);
+		
+		const int * fromVal = from->tryRo();
+		if(!fromVal)
+			return TransResult::Abort;
+		
+		if(*fromVal < amount){
+			failedCnt++;
+			if(!isIrr && failedCnt >= selfAbortThreshold){
+				Tm::abortT();
+				return TransResult::SelfAbort;
+			}
+			if(!from->tryRw() || !to->tryRw())
+				return TransResult::Abort;
+			continue;
+		}
+		
+		int * fromRw = from->tryRw();
+		if(!fromRw)
+			return TransResult::Abort;
+		*fromRw -= amount;
+		int * toRw = to->tryRw();
+		if(!toRw)
+			return TransResult::Abort;
+		*toRw += amount;
+	}
+	
+	while(readIt!=tx.reads()){
+		const int * val = vars[tx.read(readIt)]->tryRo();
+		if(!val)
+			return TransResult::Abort;
+		lastRead = *val;
+		++readIt;
+	}
+	
+	if(shallBecomeIrr && i == whenIrr && Tm::tryIrrT() != Tm::TxStatus::ok)
+		return TransResult::Abort;
+	
+	attemptIrr = Tm::irrevocableT();
+	CommitTimer timer(threadStats);
+	if(Tm::tryCommitT() != Tm::TxStatus::ok)
+		return TransResult::Abort;
+	
+	return TransResult::Success;
+}
+
+/**
+ * runs body (a function for Tm::atomically) till it commits or gives up, and records it in threadStats
+ * 
+ * An attempt lasts till the next one starts, so here attempt latency includes the backoff after an abort.
+ */
+template <typename Body>
+Tm::TxStatus runTimed(stats & threadStats, Body body, Tm::TxMode mode = Tm::ReadWrite, Clock::time_point transactionStart = Clock::now()) {
+	long long allocationsBefore = allocations;
+	int attempts = 0;
+	Clock::time_point attemptStart = transactionStart;
+	
+	Tm::RetryPolicy policy;
+	policy.contentionManager = contentionManager;
+	policy.mode = mode;
+	
+	Tm::TxStatus res = Tm::atomically([&]() -> bool {
+		if(attempts){
+			threadStats.attemptLatency[attemptIrr].record(nsSince(attemptStart));
+			attemptStart = Clock::now();
+		}
+		++attempts;
+		attemptIrr = Tm::irrevocableT();
+		bool done = body();
+		attemptIrr = Tm::irrevocableT();
+		return done;
+	}, policy);
+	
+	threadStats.attemptLatency[attemptIrr].record(nsSince(attemptStart));
+	threadStats.allocations += allocations - allocationsBefore;
+	
+	if(res == Tm::TxStatus::ok){
+		threadStats.transactionLatency[attemptIrr].record(nsSince(transactionStart));
+		threadStats.successfull++;
+		threadStats.aborted += attempts - 1;
+	} else {
+		threadStats.selfAborted++;
+		threadStats.aborted += attempts - 1;
+	}
+	return res;
+}
+
+/// does the transfers of tx, interleaved with its reads, with the exception-free API; \returns false on abort or to give up
+bool tryTransfers(const Bench::TxRecord & tx) {
+	int failedCnt = 0;
+	uint32_t readsPerTransfer = tx.reads()/(tx.transfers()>0?tx.transfers():1);
+	uint32_t readIt = 0;
+	[[gnu::unused]] volatile int lastRead;
+	
+	for(uint32_t t = 0 ; t < tx.transfers(); ++t) {
+		for (uint32_t r=0; r < readsPerTransfer; ++r){
+			const int * val = vars[tx.read(readIt)]->tryRo();
+			if(!val)
+				return false;
+			lastRead = *val;
+			++readIt;
+		}
+		
+		Tm::Variable<int> * from   = vars[tx.from(t)];
+		Tm::Variable<int> * to     = vars[tx.to(t)];
+		int                 amount = tx.amount(t);
+		
+		const int * fromVal = from->tryRo();
+		if(!fromVal)
+			return false;
+		
+		if(*fromVal < amount){
+			failedCnt++;
+			if(!Tm::irrevocableT() && failedCnt >= selfAbortThreshold)
+				// give up (atomically aborts the transaction)
+				return false;
+			if(!from->tryRw() || !to->tryRw())
+				return false;
+			continue;
+		}
+		
+		int * fromRw = from->tryRw();
+		if(!fromRw)
+			return false;
+		*fromRw -= amount;
+		int * toRw = to->tryRw();
+		if(!toRw)
+			return false;
+		*toRw += amount;
+	}
+	
+	while(readIt!=tx.reads()){
+		const int * val = vars[tx.read(readIt)]->tryRo();
+		if(!val)
+			return false;
+		lastRead = *val;
+		++readIt;
+	}
+	return true;
+}
+
+/// lets Tm::atomically retry the transaction; it decides on its own when to go irrevocable (legacy policy stands for the default one)
+void runAtomically(const Bench::TxRecord & tx, stats & threadStats, Clock::time_point transactionStart) {
+	runTimed(threadStats, [&](){return tryTransfers(tx);}, readOnlyMode ? Tm::ReadOnly : Tm::ReadWrite, transactionStart);
+}
+
+//////////////////////////////
+//////////////////////////////
+
+void Lookup::generate(int, Generator & g, vector<uint32_t> & words) {
+	uniform_int_distribution<> updateDist(0, 99);
+	int transfers = updateDist(g.engine) < updatePercent ? transfersPerTransaction : 0;
+	Bench::TxRecord::append(words, transfers, readsPerTransaction, -1);
+	generateTransfers(g, words, transfers);
+	generateReads(g, words, readsPerTransaction);
+}
+
+void Lookup::transaction(stats & threadStats, const Bench::TxRecord & tx) {
+	// most lookups write nothing, so they start as ReadOnly
+	runTimed(threadStats, [&](){return tryTransfers(tx);}, Tm::ReadOnly);
+}
+
+bool Scan::setup() {
+	return scanners >= 0 && scanners <= driver.threads;
+}
+
+void Scan::generate(int thread, Generator & g, vector<uint32_t> & words) {
+	// scanners need no records but empty ones
+	int transfers = thread >= scanners ? transfersPerTransaction : 0;
+	Bench::TxRecord::append(words, transfers, 0, -1);
+	generateTransfers(g, words, transfers);
+}
+
+void Scan::transaction(stats & threadStats, const Bench::TxRecord & tx) {
+	if(Bench::threadIndex() >= scanners){
+		runTimed(threadStats, [&](){return tryTransfers(tx);});
+		return;
+	}
+	
+	int sum = 0;
+	Tm::TxStatus res = runTimed(threadStats, [&]() -> bool {
+		sum = 0;
+		for(auto v : vars){
+			const int * val = v->tryRo();
+			if(!val)
+				return false;
+			sum += *val;
+		}
+		return true;
+	}, Tm::ReadOnly);
+	
+	if(res == Tm::TxStatus::ok){
+		threadStats.scans++;
+		if(sum != varsSum)
+			threadStats.tornScans++;
+	}
+}
+
+void IrrevocableIo::FileCloser::operator () (FILE * f) const {
+	if(fclose(f) != 0)
+		perror(ioFile.empty() ? "tmpfile" : ioFile.c_str());
+}
+
+bool IrrevocableIo::setup() {
+	if(ioThreads < 0 || ioThreads > driver.threads)
+		return false;
+	file.reset(ioFile.empty() ? tmpfile() : fopen(ioFile.c_str(), "a"));
+	if(!file){
+		perror(ioFile.empty() ? "tmpfile" : ioFile.c_str());
+		return false;
+	}
+	fd = fileno(file.get());
+	return true;
+}
+
+void IrrevocableIo::generate(int thread, Generator & g, vector<uint32_t> & words) {
+	// irrevocable ones only transfer
+	int reads = thread >= ioThreads ? readsPerTransaction : 0;
+	Bench::TxRecord::append(words, transfersPerTransaction, reads, thread >= ioThreads ? -1 : 0);
+	generateTransfers(g, words, transfersPerTransaction);
+	generateReads(g, words, reads);
+}
+
+void IrrevocableIo::transaction(stats & threadStats, const Bench::TxRecord & tx) {
+	if(Bench::threadIndex() >= ioThreads){
+		runTimed(threadStats, [&](){return tryTransfers(tx);});
+		return;
+	}
+	
+	runTimed(threadStats, [&]() -> bool {
+		// I/O can't be undone, so the transaction goes irrevocable before doing anything
+		if(!Tm::irrevocableT() && Tm::tryIrrT() != Tm::TxStatus::ok)
+			return false;
+		if(!tryTransfers(tx))
+			return false;
+		char line[64];
+		int length = snprintf(line, sizeof(line), "%d: %u transfers\n", Bench::threadIndex(), tx.transfers());
+		if(write(fd, line, length) != length)
+			perror("write");
+		return true;
+	});
+}
+
 void finalChecks(){
 	int endSum = 0;
 	try{
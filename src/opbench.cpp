@@ -0,0 +1,372 @@
+#include "tmapi.h"
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cmath>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+/*
+ * Single-threaded cost of the transactional operations on a conflict-free path.
+ * Each measurement runs transactions touching `accesses` distinct variables;
+ * the cost of a baseline transaction (usually the empty one) is subtracted and
+ * the rest is divided by the number of operations. Each figure is the mean over
+ * several rounds, ± the standard deviation of the rounds.
+ *
+ * The shared read fixture is the one exception: there `threads` threads run
+ * read-only transactions over the very same variables at once, which shows what
+ * visible reads cost once the variables' cache lines are shared between cores.
+ * In the readers fixture, `threads` threads read all the variables and stay in their
+ * transactions, so that each commit of the writer has to deal with all of them.
+ * In the hijack fixture, `threads` threads keep committing writes to the variables
+ * an irrevocable transaction writes; the irrevocable transaction takes over the
+ * write buffers of those it meets in the middle of their commits.
+ *
+ * Variables hold `size` bytes; sizes up to 8 are stored inline.
+ */
+
+// benchmark parameters:
+int accesses;
+int transactions;
+int rounds;
+int threads;
+int valueSize;
+
+/// how many times repeated-access fixtures go over the variables after the first pass
+const int repeatPasses = 10;
+
+/// value of a variable: `bytes` bytes, of which the first one is counted up by writes
+template <size_t bytes>
+struct Value {
+	unsigned char data[bytes];
+
+	Value(int v = 0) {
+		for(auto & b : data)
+			b = (unsigned char) v;
+	}
+
+	operator int() const {return data[0];}
+
+	Value & operator ++ (int) {
+		++data[0];
+		return *this;
+	}
+};
+
+/// mean and standard deviation of a measurement, in ns
+struct Result {
+	double mean;
+	double stddev;
+
+	/// (this - baseline) / ops
+	Result perOp(const Result & baseline, double ops) const {
+		return Result{(mean - baseline.mean) / ops, sqrt(stddev * stddev + baseline.stddev * baseline.stddev) / ops};
+	}
+};
+
+void setup(int argc, char ** argv);
+
+template <typename Body>
+Result measure(Body body){
+	// warm up caches and any capacity the TM keeps around
+	for(int t = 0 ; t < transactions/10 + 1; ++t)
+		body();
+
+	double sum = 0, sumSq = 0;
+	for(int r = 0 ; r < rounds; ++r){
+		auto start = chrono::steady_clock::now();
+		for(int t = 0 ; t < transactions; ++t)
+			body();
+		auto stop = chrono::steady_clock::now();
+		double ns = chrono::duration<double, nano>(stop-start).count() / transactions;
+		sum += ns;
+		sumSq += ns * ns;
+	}
+	double mean = sum / rounds;
+	return Result{mean, sqrt(max(0.0, sumSq / rounds - mean * mean))};
+}
+
+/// runs measure(body) in `threads` threads at once; \returns the mean of their results
+template <typename Body>
+Result measureShared(Body body){
+	atomic<int> ready {0};
+	atomic<bool> go {false};
+	vector<Result> results(threads);
+	vector<thread> workers;
+
+	for(int i = 0 ; i < threads; ++i)
+		workers.emplace_back([&, i](){
+			++ready;
+			while(!go)
+				this_thread::yield();
+			results[i] = measure(body);
+		});
+
+	while(ready != threads)
+		this_thread::yield();
+	go = true;
+
+	Result sum {0, 0};
+	for(int i = 0 ; i < threads; ++i){
+		workers[i].join();
+		sum.mean += results[i].mean;
+		sum.stddev += results[i].stddev;
+	}
+	return Result{sum.mean / threads, sum.stddev / threads};
+}
+
+/// measure(body) while `threads` threads sit in transactions that read all variables
+template <typename V, typename Body>
+Result measureUnderReaders(vector<Tm::Variable<V>*> & vars, Body body){
+	atomic<int> parked {0};
+	atomic<bool> release {false};
+	vector<thread> readers;
+
+	for(int i = 0 ; i < threads; ++i)
+		readers.emplace_back([&](){
+			[[gnu::unused]] volatile int sink;
+			Tm::beginT();
+			for(auto v : vars)
+				sink = v->ro();
+			++parked;
+			while(!release)
+				this_thread::yield();
+			// killed by the writer long ago
+			Tm::tryCommitT();
+		});
+
+	while(parked != threads)
+		this_thread::yield();
+
+	Result result = measure(body);
+
+	release = true;
+	for(auto & r : readers)
+		r.join();
+	return result;
+}
+
+/// measure(body) while `threads` threads keep committing writes to all variables
+template <typename V, typename Body>
+Result measureUnderWriters(vector<Tm::Variable<V>*> & vars, Body body){
+	atomic<bool> stop {false};
+	vector<thread> writers;
+
+	for(int i = 0 ; i < threads; ++i)
+		writers.emplace_back([&](){
+			while(!stop.load(memory_order_relaxed))
+				Tm::atomically([&](){
+					for(auto v : vars){
+						V * value = v->tryRw();
+						if(!value)
+							return false;
+						(*value)++;
+					}
+					return true;
+				});
+		});
+
+	Result result = measure(body);
+
+	stop = true;
+	for(auto & w : writers)
+		w.join();
+	return result;
+}
+
+void print(const char * name, const Result & r, const char * unit = "ns/op", const char * note = ""){
+	printf("%-24s %8.1f ± %6.1f %s%s\n", name, r.mean, r.stddev, unit, note);
+}
+
+template <typename V>
+void runSuite(){
+	vector<Tm::Variable<V>*> vars;
+	for(int i = 0 ; i < accesses; ++i)
+		vars.push_back(new Tm::Variable<V>(V(i)));
+
+	[[gnu::unused]] volatile int sink;
+
+	Result empty = measure([&](){
+		Tm::beginT();
+		Tm::commitT();
+	});
+
+	Result firstRead = measure([&](){
+		Tm::beginT();
+		for(auto v : vars)
+			sink = v->ro();
+		Tm::commitT();
+	});
+
+	Result repeatedRead = measure([&](){
+		Tm::beginT();
+		for(int pass = 0 ; pass < repeatPasses + 1; ++pass)
+			for(auto v : vars)
+				sink = v->ro();
+		Tm::commitT();
+	});
+
+	Result emptyReadOnly = measure([&](){
+		Tm::beginT(Tm::ReadOnly);
+		Tm::commitT();
+	});
+
+	Result firstReadReadOnly = measure([&](){
+		Tm::beginT(Tm::ReadOnly);
+		for(auto v : vars)
+			sink = v->ro();
+		Tm::commitT();
+	});
+
+	Result firstWrite = measure([&](){
+		Tm::beginT();
+		for(auto v : vars)
+			v->rw()++;
+		Tm::commitT();
+	});
+
+	Result repeatedWrite = measure([&](){
+		Tm::beginT();
+		for(int pass = 0 ; pass < repeatPasses + 1; ++pass)
+			for(auto v : vars)
+				v->rw()++;
+		Tm::commitT();
+	});
+
+	Result readThenWrite = measure([&](){
+		Tm::beginT();
+		for(auto v : vars)
+			sink = v->ro();
+		for(auto v : vars)
+			v->rw()++;
+		Tm::commitT();
+	});
+
+	// irrT() has to lock the whole read set, so it's charged per variable read before
+	Result readThenIrr = measure([&](){
+		Tm::beginT();
+		for(auto v : vars)
+			sink = v->ro();
+		Tm::irrT();
+		Tm::commitT();
+	});
+
+	Result emptyIrr = measure([&](){
+		Tm::beginT();
+		Tm::irrT();
+		Tm::commitT();
+	});
+
+	Result irrWrite = measure([&](){
+		Tm::beginT();
+		Tm::irrT();
+		for(auto v : vars)
+			v->rw()++;
+		Tm::commitT();
+	});
+
+	Result writeUnderReaders = measureUnderReaders(vars, [&](){
+		Tm::beginT();
+		for(auto v : vars)
+			v->rw()++;
+		Tm::commitT();
+	});
+
+	Tm::Stats beforeHijacks = Tm::stats();
+	Result irrWriteUnderWriters = measureUnderWriters(vars, [&](){
+		Tm::beginT();
+		Tm::irrT();
+		for(auto v : vars)
+			v->rw()++;
+		Tm::commitT();
+	});
+	Tm::Stats duringHijacks = Tm::stats() - beforeHijacks;
+
+	Result sharedEmpty = measureShared([&](){
+		Tm::beginT();
+		Tm::commitT();
+	});
+
+	Result sharedRead = measureShared([&](){
+		Tm::beginT();
+		for(auto v : vars)
+			sink = v->ro();
+		Tm::commitT();
+	});
+
+	char note[80], label[40];
+
+	print("Empty transaction:", empty, "ns");
+	print("ro() first access:", firstRead.perOp(empty, accesses));
+	print("ro() repeated access:", repeatedRead.perOp(firstRead, accesses * repeatPasses));
+	print("Empty ReadOnly trans.:", emptyReadOnly, "ns");
+	print("ro() in ReadOnly:", firstReadReadOnly.perOp(emptyReadOnly, accesses));
+	print("rw() first access:", firstWrite.perOp(empty, accesses), "ns/op", " (incl. commit)");
+	print("rw() repeated access:", repeatedWrite.perOp(firstWrite, accesses * repeatPasses));
+	print("rw() after ro():", readThenWrite.perOp(firstRead, accesses), "ns/op", " (incl. commit)");
+	print("Empty irrevocable:", emptyIrr, "ns");
+	snprintf(label, sizeof(label), "irrT() after %d ro():", accesses);
+	print(label, readThenIrr.perOp(firstRead, 1), "ns");
+	print("irrT() per read locked:", readThenIrr.perOp(firstRead, 1).perOp(emptyIrr.perOp(empty, 1), accesses));
+	print("rw() irrevocable:", irrWrite.perOp(emptyIrr, accesses), "ns/op", " (incl. commit)");
+	snprintf(label, sizeof(label), "rw() with %2d readers:", threads);
+	print(label, writeUnderReaders.perOp(empty, accesses), "ns/op", " (incl. commit)");
+	snprintf(label, sizeof(label), "rw() irr., %2d writers:", threads);
+	uint64_t irrAccesses = duringHijacks.irrevocable * accesses;
+	snprintf(note, sizeof(note), " (incl. commit; %.4f hijacks/op)", irrAccesses ? double(duringHijacks.hijacks) / irrAccesses : 0.0);
+	print(label, irrWriteUnderWriters.perOp(emptyIrr, accesses), "ns/op", note);
+	snprintf(label, sizeof(label), "ro() shared, %2d thr:", threads);
+	print(label, sharedRead.perOp(sharedEmpty, accesses));
+
+	for(auto v : vars)
+		delete v;
+}
+
+int main(int argc, char ** argv){
+	setup(argc, argv);
+
+	switch(valueSize){
+		case 1:    runSuite<Value<1>>();    break;
+		case 8:    runSuite<Value<8>>();    break;
+		case 64:   runSuite<Value<64>>();   break;
+		case 1024: runSuite<Value<1024>>(); break;
+		case 4:
+		default:   runSuite<int>();         break;
+	}
+
+	return 0;
+}
+
+void setup(int argc, char ** argv){
+	boost::program_options::options_description opts;
+	opts.add_options()
+		("accesses,n", boost::program_options::value<int>(&accesses)->default_value(100), "Distinct variables accessed per transaction")
+		("transactions,x", boost::program_options::value<int>(&transactions)->default_value(20000), "Transactions per round")
+		("rounds,R", boost::program_options::value<int>(&rounds)->default_value(5), "Rounds per measurement (mean ± standard deviation is reported)")
+		("threads,t", boost::program_options::value<int>(&threads)->default_value(4), "Threads in the shared read, readers and writers fixtures")
+		("size,b", boost::program_options::value<int>(&valueSize)->default_value(4), "Bytes per variable: 1, 4 (int), 8, 64 or 1024")
+		("help,h", "this help")
+	;
+
+	boost::program_options::variables_map vm;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, opts), vm);
+	boost::program_options::notify(vm);
+
+	if (vm.count("help")) {
+		cout << opts << "\n";
+		exit(0);
+	}
+
+	if(accesses < 1 || transactions < 1 || rounds < 1 || threads < 1 || (unsigned) threads >= Tm::maxThreadNum ||
+	   (valueSize != 1 && valueSize != 4 && valueSize != 8 && valueSize != 64 && valueSize != 1024)){
+		printf("Stupid arguments detected. Be gone!\n");
+		exit(1);
+	}
+
+	printf("Accesses/transaction: %d\nTransactions: %d\nRounds: %d\nThreads: %d\nValue size: %d B\n", accesses, transactions, rounds, threads, valueSize);
+}
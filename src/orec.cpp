@@ -0,0 +1,45 @@
+#include "tmapi.h"
+#include "orec.h"
+
+#if TM_METADATA == TM_METADATA_STRIPED
+
+#include <cstdlib>
+#include <new>
+
+namespace Tm {
+
+Orec * orecs = nullptr;
+size_t orecMask = 0;
+
+namespace {
+
+bool createOrecs() {
+	size_t stripes = 1;
+	while(stripes < orecStripes)
+		stripes <<= 1;
+
+	// the table starts a cache line, so that padded Orecs are really padded
+	void * memory;
+	if(posix_memalign(&memory, cacheLineSize, stripes * sizeof(Orec)))
+		throw bad_alloc();
+
+	Orec * table = (Orec*) memory;
+	for(size_t i = 0 ; i < stripes; ++i)
+		new (table + i) Orec();
+
+	orecMask = stripes - 1;
+	orecs = table;
+	return true;
+}
+
+/*anonymous namespace end*/}
+
+void initOrecs() {
+	// thread-safe, and a single load once the table exists
+	static const bool created = createOrecs();
+	(void) created;
+}
+
+/*namespace TM end*/}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef OREC_H
+#define OREC_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "layout.h"
+#include "transaction.h"
+#include "readerset.h"
+#include "tmapi.h"
+
+using namespace std;
+
+namespace Tm {
+
+/**
+ * \brief Ownership record: everything the TM knows about a variable, except for its value.
+ *
+ * With per-variable metadata VariableBase derives from Orec. With striped metadata variables share
+ * Orecs from a global table, and all the protocol sees is bigger variables - except that a transaction
+ * may meet the lock it holds, or flags it set, once more through another variable.
+ */
+struct TM_OREC_ALIGNMENT Orec {
+
+	Orec() = default;
+
+	Orec(const Orec &) = delete;
+
+#if TM_METADATA == TM_METADATA_PER_VARIABLE
+	// Puts the vtable pointer of VariableBase in front of the fields. Otherwise an aligned Orec
+	// would go to the next cache line, after the vtable pointer, wasting one.
+	virtual ~Orec(){}
+#endif
+
+#if TM_LAYOUT == TM_LAYOUT_SPLIT
+
+	// Written on each access: they share the line with the vtable pointer (if there's any).
+	atomic_flag lock {ATOMIC_FLAG_INIT};
+	atomic<TxRef> mostRecentLockOwner {0};
+	ReaderSet readers {maxThreadNum};
+
+	// Written only by commits: readers poll these (and the value of Variable<T>, which comes next, if any)
+	// on a line of their own, so the lock traffic of writers does not invalidate it.
+	alignas(cacheLineSize) atomic<bool> usedByIrr {false};
+	atomic<bool> dirty {false};
+	atomic<bool> dirtyIrr {false};
+
+#else
+
+	atomic<bool> usedByIrr {false};
+
+	/// when var is dirty, then value and version are not consistent
+	atomic<bool> dirty {false};
+
+	/// we need another dirty for the irrevocable transaction for hijack-related reasons
+	atomic<bool> dirtyIrr {false};
+
+	/// the transaction which has the lock can update global copy (i.e. var)
+	atomic_flag lock {ATOMIC_FLAG_INIT};
+
+	/// slots of threads whose running transactions read the variable
+	ReaderSet readers {maxThreadNum};
+
+	/// overwritten after successful lock
+	atomic<TxRef> mostRecentLockOwner {0};
+
+#endif
+
+};
+
+#if TM_METADATA == TM_METADATA_STRIPED
+
+/// the table of orecStripes (rounded up to a power of two) Orecs; created by \sa{initOrecs}, never freed
+extern Orec * orecs;
+extern size_t orecMask;
+
+/// creates the table, unless it exists already; called on constructing each variable
+void initOrecs();
+
+/// \returns Orec of the variable at given address
+inline Orec & orecOf(const void * var) {
+	// Fibonacci hashing, so that neighbouring variables get unrelated stripes
+	uint64_t hash = uint64_t(uintptr_t(var)) * 0x9E3779B97F4A7C15ull;
+	return orecs[(hash >> 32) & orecMask];
+}
+
+#endif
+
+/*namespace TM end*/}
+
+#endif // OREC_H
@@ -0,0 +1,110 @@
+#include "perfcounters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Bench {
+
+namespace {
+
+struct CounterKind {
+	uint32_t type;
+	uint64_t config;
+};
+
+const CounterKind counterKinds[PerfCounts::kinds] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+int openCounter(const CounterKind & kind, bool excludeKernel) {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = kind.type;
+	attr.config = kind.config;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.exclude_kernel = excludeKernel;
+	attr.exclude_hv = 1;
+	// this thread, any CPU, no group
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*anonymous namespace end*/}
+
+const char * PerfCounts::name(Kind kind) {
+	switch(kind) {
+		case cycles:          return "cycles";
+		case instructions:    return "instructions";
+		case l1dMisses:       return "L1d misses";
+		case llcMisses:       return "LLC misses";
+		case branchMisses:    return "branch misses";
+		case contextSwitches: return "ctx switches";
+		case kinds:           break;
+	}
+	return "?";
+}
+
+PerfCounts PerfCounts::operator - (const PerfCounts & earlier) const {
+	PerfCounts d = *this;
+	for(int k = 0 ; k < kinds; ++k)
+		d.values[k] -= earlier.values[k];
+	return d;
+}
+
+PerfCounts & PerfCounts::operator += (const PerfCounts & other) {
+	for(int k = 0 ; k < kinds; ++k){
+		values[k] += other.values[k];
+		available[k] = available[k] || other.available[k];
+	}
+	return *this;
+}
+
+void PerfCounts::normalized(vector<pair<string, double>> & metrics, const string & per, double count) const {
+	if(!count)
+		return;
+	for(int k = 0 ; k < kinds; ++k)
+		if(available[k])
+			metrics.push_back(make_pair(string(name(Kind(k))) + "/" + per, values[k] / count));
+}
+
+PerfCounters::PerfCounters() {
+	for(int k = 0 ; k < PerfCounts::kinds; ++k){
+		// user space only, unless the kernel is where the event happens
+		bool kernelEvent = k == PerfCounts::contextSwitches;
+		fds[k] = openCounter(counterKinds[k], !kernelEvent);
+		if(fds[k] < 0 && kernelEvent)
+			fds[k] = openCounter(counterKinds[k], true);
+		errors[k] = fds[k] < 0 ? strerror(errno) : nullptr;
+	}
+}
+
+PerfCounters::~PerfCounters() {
+	for(int fd : fds)
+		if(fd >= 0)
+			close(fd);
+}
+
+PerfCounts PerfCounters::read() const {
+	PerfCounts counts;
+	for(int k = 0 ; k < PerfCounts::kinds; ++k){
+		// value, time enabled, time running
+		uint64_t data[3];
+		if(fds[k] < 0 || ::read(fds[k], data, sizeof(data)) != sizeof(data))
+			continue;
+		counts.available[k] = true;
+		// multiplexed: extrapolate to the whole time enabled
+		counts.values[k] = data[2] && data[2] < data[1] ? uint64_t(double(data[0]) * data[1] / data[2]) : data[0];
+	}
+	return counts;
+}
+
+/*namespace Bench end*/}
@@ -0,0 +1,61 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+/**
+ * \file perfcounters.h
+ * \brief Hardware and software performance counters of the calling thread, through Linux perf_event_open.
+ *
+ * Each counter is opened on its own, so that whatever the kernel, the CPU or perf_event_paranoid do not
+ * allow is merely left out. Counters are scaled when the kernel had to multiplex them.
+ */
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace Bench {
+
+/// values of all kinds of counters, of one thread or summed up
+struct PerfCounts {
+	enum Kind {cycles, instructions, l1dMisses, llcMisses, branchMisses, contextSwitches, kinds};
+
+	uint64_t values[kinds] = {};
+	/// kinds that could be counted
+	bool available[kinds] = {};
+
+	/// \returns a short name of kind, e.g. "cycles"
+	static const char * name(Kind kind);
+
+	PerfCounts operator - (const PerfCounts & earlier) const;
+	PerfCounts & operator += (const PerfCounts & other);
+
+	/// appends "<counter>/<per>" = value / count for each available counter to metrics (nothing if count is 0)
+	void normalized(vector<pair<string, double>> & metrics, const string & per, double count) const;
+};
+
+/// counters of the thread that created it
+class PerfCounters {
+public:
+	/// opens all kinds it can for the calling thread
+	PerfCounters();
+	PerfCounters(const PerfCounters &) = delete;
+	PerfCounters & operator = (const PerfCounters &) = delete;
+	~PerfCounters();
+
+	/// \returns the counts since the counters were opened
+	PerfCounts read() const;
+
+	/// \returns why kind is not available, or nullptr if it is
+	const char * unavailable(PerfCounts::Kind kind) const {return fds[kind] < 0 ? errors[kind] : nullptr;}
+
+private:
+	int fds[PerfCounts::kinds];
+	const char * errors[PerfCounts::kinds];
+};
+
+/*namespace Bench end*/}
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,168 @@
+#include "pool.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+
+namespace Tm {
+
+namespace {
+
+/// 16 bytes for each size up to 128, then powers of two up to BlockPool::maxPooledSize
+const size_t sizeClassNum = 11;
+
+size_t sizeClassOf(size_t size) {
+	if(size <= 128)
+		return size == 0 ? 0 : (size-1) / 16;
+	if(size <= 256)
+		return 8;
+	if(size <= 512)
+		return 9;
+	return 10;
+}
+
+size_t sizeOfClass(size_t sizeClass) {
+	if(sizeClass < 8)
+		return (sizeClass+1) * 16;
+	return size_t(256) << (sizeClass - 8);
+}
+
+struct FreeBlock {
+	FreeBlock * next;
+};
+
+struct ThreadPools;
+
+struct FreeList {
+	/// blocks freed by the owner thread, touched only by the owner
+	FreeBlock * local = nullptr;
+
+	/// blocks freed by other threads
+	atomic<FreeBlock*> remote {nullptr};
+
+	ThreadPools * pools;
+};
+
+/// precedes each block; 16 bytes keep the payload aligned like malloc does
+struct alignas(16) BlockHeader {
+	/// list the block returns to, nullptr for blocks that are not pooled
+	FreeList * owner;
+};
+
+struct ThreadPools {
+	FreeList lists[sizeClassNum];
+
+	ThreadPools() {
+		for(auto & l : lists)
+			l.pools = this;
+	}
+};
+
+/// lists of finished threads, waiting for adoption
+mutex orphansMutex;
+vector<ThreadPools*> orphans;
+
+thread_local ThreadPools * myPools = nullptr;
+
+/// set once the lists of this thread are handed over at thread exit
+thread_local bool poolsRetired = false;
+
+struct PoolsGuard {
+	~PoolsGuard() {
+		// blocks may still come back to these lists, so they are never freed, just handed over
+		lock_guard<mutex> lock(orphansMutex);
+		orphans.push_back(myPools);
+		myPools = nullptr;
+		poolsRetired = true;
+	}
+};
+
+ThreadPools * adoptPools() {
+	// thread start is not a transactional operation, so a mutex here is fine
+	{
+		lock_guard<mutex> lock(orphansMutex);
+		if(!orphans.empty()) {
+			myPools = orphans.back();
+			orphans.pop_back();
+		}
+	}
+	if(!myPools)
+		myPools = new ThreadPools;
+
+	// constructed here, so it is destroyed (and hands the lists over) on thread exit
+	static thread_local PoolsGuard guard;
+	(void) guard;
+
+	return myPools;
+}
+
+inline ThreadPools * pools() {
+	if(myPools)
+		return myPools;
+	if(poolsRetired)
+		// thread is exiting
+		return nullptr;
+	return adoptPools();
+}
+
+/*anonymous namespace end*/}
+
+
+void * BlockPool::allocate(size_t size) {
+	ThreadPools * p = size <= maxPooledSize ? pools() : nullptr;
+
+	if(!p) {
+		BlockHeader * header = static_cast<BlockHeader*>(::operator new(sizeof(BlockHeader) + size));
+		header->owner = nullptr;
+		return header + 1;
+	}
+
+	size_t sizeClass = sizeClassOf(size);
+	FreeList & list = p->lists[sizeClass];
+
+	if(!list.local)
+		// take over everything other threads gave back
+		list.local = list.remote.exchange(nullptr, memory_order_acquire);
+
+	BlockHeader * header;
+	if(list.local) {
+		FreeBlock * block = list.local;
+		list.local = block->next;
+		header = reinterpret_cast<BlockHeader*>(block) - 1;
+	} else {
+		header = static_cast<BlockHeader*>(::operator new(sizeof(BlockHeader) + sizeOfClass(sizeClass)));
+		header->owner = &list;
+	}
+
+	return header + 1;
+}
+
+void BlockPool::deallocate(void * ptr) {
+	if(!ptr)
+		return;
+
+	BlockHeader * header = static_cast<BlockHeader*>(ptr) - 1;
+	FreeList * list = header->owner;
+
+	if(!list) {
+		::operator delete(header);
+		return;
+	}
+
+	FreeBlock * block = static_cast<FreeBlock*>(ptr);
+
+	if(list->pools == myPools) {
+		block->next = list->local;
+		list->local = block;
+		return;
+	}
+
+	// push only; the owner takes the whole list at once, so there is no ABA problem
+	FreeBlock * head = list->remote.load(memory_order_relaxed);
+	do {
+		block->next = head;
+	} while(!list->remote.compare_exchange_weak(head, block, memory_order_release, memory_order_relaxed));
+}
+
+/*namespace TM end*/}
@@ -0,0 +1,63 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+
+using namespace std;
+
+namespace Tm {
+
+/**
+ * \brief Recycles small memory blocks so that steady-state transactions do not go to malloc.
+ *
+ * Every thread owns a free list per size class. A block can be freed by any thread, but it always
+ * returns to the list it was carved for: frees done by the owner are plain pushes, frees done by
+ * other threads are pushed on a lock-free list that the owner takes over in one exchange.
+ *
+ * Lists of a finished thread are handed over to the next thread that starts allocating,
+ * so memory is bounded by the number of live threads and not by the number of threads ever started.
+ *
+ * Blocks larger than maxPooledSize are passed straight to operator new / delete.
+ */
+class BlockPool {
+public:
+	/// largest block size served from free lists
+	static const size_t maxPooledSize = 1024;
+
+	/// \returns block of at least size bytes, aligned as operator new would align it
+	static void * allocate(size_t size);
+
+	/// returns block obtained from allocate()
+	static void deallocate(void * block);
+};
+
+/// standard allocator on top of BlockPool, e.g. for allocate_shared or shared_ptr control blocks
+template <typename T>
+struct PoolAllocator {
+	typedef T value_type;
+
+	PoolAllocator() = default;
+
+	template <typename U>
+	PoolAllocator(const PoolAllocator<U> &) {}
+
+	T * allocate(size_t n) {
+		// blocks follow a 16-byte header, which is all the alignment they get
+		static_assert(alignof(T) <= 16, "BlockPool cannot serve types aligned beyond 16 bytes");
+		return static_cast<T*>(BlockPool::allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T * p, size_t) {
+		BlockPool::deallocate(p);
+	}
+
+	template <typename U>
+	bool operator==(const PoolAllocator<U> &) const {return true;}
+
+	template <typename U>
+	bool operator!=(const PoolAllocator<U> &) const {return false;}
+};
+
+/*namespace TM end*/}
+
+#endif // POOL_H
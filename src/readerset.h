@@ -0,0 +1,99 @@
+#ifndef READERSET_H
+#define READERSET_H
+
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+namespace Tm {
+
+/**
+ * \brief Thread slots whose running transactions read a variable, one bit per slot.
+ *
+ * A reader sets its bit on the first visible read and clears it when its transaction ends, so a writer
+ * only needs to look at the set bits and kill whatever transaction currently runs in these slots.
+ * A committing writer ORs the sets of all variables it writes into one bitmap (see addTo), so each
+ * reader is killed once per commit, and a variable nobody reads costs a single load.
+ *
+ * The first 64 slots are kept inline; only programs with more threads pay for an overflow array.
+ * The number of slots is fixed on construction.
+ */
+class ReaderSet {
+public:
+	static const unsigned bitsPerWord = 64;
+
+	explicit ReaderSet(unsigned slots) :
+		overflow(slots > bitsPerWord ? new atomic<uint64_t>[(slots - 1) / bitsPerWord]() : nullptr),
+		words(wordsFor(slots))
+	{}
+
+	/// \returns size of a bitmap covering given number of slots, in words
+	static unsigned wordsFor(unsigned slots) {
+		return (slots + bitsPerWord - 1) / bitsPerWord;
+	}
+
+	ReaderSet(const ReaderSet &) = delete;
+
+	~ReaderSet() {
+		delete [] overflow;
+	}
+
+	/// marks slot as reader; seq_cst, as the reader checks if the variable is dirty right afterwards
+	void add(unsigned slot) {
+		word(slot).fetch_or(bit(slot), memory_order_seq_cst);
+	}
+
+	/// unmarks slot, unless it is not marked anyway (this spares a write to a shared cache line)
+	void remove(unsigned slot) {
+		atomic<uint64_t> & w = word(slot);
+		if(w.load(memory_order_relaxed) & bit(slot))
+			w.fetch_and(~bit(slot), memory_order_relaxed);
+	}
+
+	/// \returns if slot is marked
+	bool contains(unsigned slot) const {
+		return (slot < bitsPerWord ? first : overflow[slot / bitsPerWord - 1]).load(memory_order_relaxed) & bit(slot);
+	}
+
+	/// ORs marked slots into bitmap, which has (at least) as many words as this set
+	void addTo(uint64_t * bitmap) const {
+		// acquire, so that whatever the reader did before its first read (e.g. creating its descriptor) is visible
+		bitmap[0] |= first.load(memory_order_acquire);
+		for(unsigned i = 1 ; i < words; ++i)
+			bitmap[i] |= overflow[i-1].load(memory_order_acquire);
+	}
+
+	/// calls f(slot) for each slot marked in bitmap of given size
+	template <typename F>
+	static void forEach(const uint64_t * bitmap, unsigned words, F f) {
+		for(unsigned i = 0 ; i < words; ++i) {
+			uint64_t w = bitmap[i];
+			while(w) {
+				f(i * bitsPerWord + __builtin_ctzll(w));
+				w &= w - 1;
+			}
+		}
+	}
+
+	static uint64_t bit(unsigned slot) {
+		return uint64_t(1) << (slot % bitsPerWord);
+	}
+
+protected:
+	atomic<uint64_t> first {0};
+
+	/// slots from bitsPerWord on, nullptr if there are no such slots
+	atomic<uint64_t> * overflow;
+
+	/// total number of words, including first
+	unsigned words;
+
+	atomic<uint64_t> & word(unsigned slot) {
+		return slot < bitsPerWord ? first : overflow[slot / bitsPerWord - 1];
+	}
+};
+
+/*namespace TM end*/}
+
+#endif // READERSET_H
@@ -0,0 +1,210 @@
+#include "tmapi.h"
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+/*
+ * Large values: copying reads vs shared snapshots (see Tm::sharedSnapshots).
+ *
+ * Blob<false> is read the usual way, by copying it into a read buffer; Blob<true> opts in to
+ * shared snapshots, so that a read only takes a reference. First the single-threaded cost
+ * of ro() and rw() is measured for both, like opbench does; then `threads` readers check that
+ * each blob they see is consistent (all elements equal) while two writers, one of them
+ * irrevocable, keep replacing blobs.
+ */
+
+// benchmark parameters:
+int blobSize;
+int varsNo;
+int transactions;
+int rounds;
+int threads;
+int duration;
+
+template <bool shared>
+struct Blob {
+	vector<int> data;
+
+	explicit Blob(int value = 0) : data(blobSize, value) {}
+};
+
+namespace Tm {
+template <> struct sharedSnapshots<Blob<true>> : true_type {};
+}
+
+void setup(int argc, char ** argv);
+
+template <typename Body>
+double measure(Body body){
+	for(int t = 0 ; t < transactions/10 + 1; ++t)
+		body();
+
+	double best = -1;
+	for(int r = 0 ; r < rounds; ++r){
+		auto start = chrono::steady_clock::now();
+		for(int t = 0 ; t < transactions; ++t)
+			body();
+		auto stop = chrono::steady_clock::now();
+		double ns = chrono::duration<double, nano>(stop-start).count() / transactions;
+		if(best < 0 || ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+/// \returns false if a reader has seen a torn blob
+template <bool shared>
+bool run(const char * label){
+	vector<Tm::Variable<Blob<shared>>*> vars;
+	for(int i = 0 ; i < varsNo; ++i)
+		vars.push_back(new Tm::Variable<Blob<shared>>(Blob<shared>(i)));
+
+	[[gnu::unused]] volatile int sink;
+
+	double empty = measure([&](){
+		Tm::beginT();
+		Tm::commitT();
+	});
+
+	double firstRead = measure([&](){
+		Tm::beginT();
+		for(auto v : vars)
+			sink = v->ro().data[0];
+		Tm::commitT();
+	});
+
+	double firstWrite = measure([&](){
+		Tm::beginT();
+		for(auto v : vars)
+			v->rw().data[0]++;
+		Tm::commitT();
+	});
+
+	// blobs are uniform again before the concurrent part
+	for(auto v : vars){
+		Tm::beginT();
+		Blob<shared> & b = v->rw();
+		for(auto & x : b.data)
+			x = b.data[0];
+		Tm::commitT();
+	}
+
+	atomic<bool> stop {false};
+	atomic<bool> torn {false};
+	atomic<long long> reads {0};
+	vector<thread> workers;
+
+	for(int i = 0 ; i < threads; ++i)
+		workers.emplace_back([&, i](){
+			default_random_engine generator(i);
+			uniform_int_distribution<> varDist(0, varsNo-1);
+			long long myReads = 0;
+			while(!stop.load(memory_order_relaxed)){
+				int pick = varDist(generator);
+				Tm::atomically([&](){
+					const Blob<shared> * b = vars[pick]->tryRo();
+					if(!b)
+						return false;
+					int first = b->data[0];
+					for(int x : b->data)
+						if(x != first){
+							// a zombie may see anything; only committed reads count
+							if(Tm::tryCommitT() == Tm::TxStatus::ok)
+								torn = true;
+							return false;
+						}
+					return true;
+				});
+				++myReads;
+			}
+			reads += myReads;
+		});
+
+	// one writer retries as usual, the other one is irrevocable right away
+	for(int i = 0 ; i < 2; ++i)
+		workers.emplace_back([&, i](){
+			Tm::IrrevocableAfter irrevocable(0);
+			Tm::RetryPolicy policy;
+			if(i)
+				policy.contentionManager = &irrevocable;
+			default_random_engine generator(threads + i);
+			uniform_int_distribution<> varDist(0, varsNo-1);
+			while(!stop.load(memory_order_relaxed)){
+				int pick = varDist(generator);
+				Tm::atomically([&](){
+					Blob<shared> * b = vars[pick]->tryRw();
+					if(!b)
+						return false;
+					int next = b->data[0] + 1;
+					for(auto & x : b->data)
+						x = next;
+					return true;
+				}, policy);
+			}
+		});
+
+	this_thread::sleep_for(chrono::milliseconds(duration));
+	stop = true;
+	for(auto & w : workers)
+		w.join();
+
+	for(auto v : vars)
+		delete v;
+
+	printf("%-10s %12.1f %12.1f %14.0f\n", label, (firstRead - empty) / varsNo, (firstWrite - empty) / varsNo, reads * 1000.0 / duration);
+
+	return !torn;
+}
+
+int main(int argc, char ** argv){
+	setup(argc, argv);
+
+	printf("%-10s %12s %12s %14s\n", "reads", "ro() ns/op", "rw() ns/op", "checks/s");
+
+	bool fine = run<false>("copying");
+	fine = run<true>("snapshots") && fine;
+
+	if(fine)
+		printf("All fine\n");
+	else
+		printf("TM problem - torn blob\n");
+
+	return fine ? 0 : 1;
+}
+
+void setup(int argc, char ** argv){
+	boost::program_options::options_description opts;
+	opts.add_options()
+		("size,s", boost::program_options::value<int>(&blobSize)->default_value(1024), "Ints per blob")
+		("vars,v", boost::program_options::value<int>(&varsNo)->default_value(16), "Number of blobs")
+		("transactions,x", boost::program_options::value<int>(&transactions)->default_value(2000), "Transactions per round")
+		("rounds,R", boost::program_options::value<int>(&rounds)->default_value(5), "Rounds per measurement (best one is reported)")
+		("threads,t", boost::program_options::value<int>(&threads)->default_value(4), "Reader threads in the concurrent part")
+		("duration,d", boost::program_options::value<int>(&duration)->default_value(1000), "Duration of the concurrent part in ms")
+		("help,h", "this help")
+	;
+
+	boost::program_options::variables_map vm;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, opts), vm);
+	boost::program_options::notify(vm);
+
+	if (vm.count("help")) {
+		cout << opts << "\n";
+		exit(0);
+	}
+
+	if(blobSize < 1 || varsNo < 1 || transactions < 1 || rounds < 1 || threads < 1 || (unsigned) threads + 2 >= Tm::maxThreadNum || duration < 1){
+		printf("Stupid arguments detected. Be gone!\n");
+		exit(1);
+	}
+
+	printf("Blob: %d ints\nBlobs: %d\nTransactions: %d\nRounds: %d\nReaders: %d\nDuration: %d ms\n", blobSize, varsNo, transactions, rounds, threads, duration);
+}
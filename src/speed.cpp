@@ -5,20 +5,19 @@
 #include <atomic>
 #include <random>
 #include <list>
+#include <iostream>
+#include <set>
+#include <tuple>
+#include <algorithm>
 
-#include <boost/program_options.hpp>
-
-// C++11 has no thread interrupt at all :(
-#include <boost/thread.hpp>
-// but at least I don't have to implement barriers 
-#include <boost/thread/barrier.hpp>
-#include <boost/chrono.hpp>
+#include "driver.h"
 
 using namespace std;
 
+/// threads, windows, output (see driver.h)
+Bench::Driver driver("speed");
+
 // benchmark parameters:
-const int threadNo = 1;
-int timeSecs;
 int varsNo;
 int transfersPerTransaction;
 int readsPerTransaction;
@@ -26,7 +25,7 @@ int readsPerTransaction;
 bool irr = false;
 
 
-thread_local default_random_engine generator(boost::chrono::high_resolution_clock::now().time_since_epoch().count());
+thread_local default_random_engine generator(driver.seedFor(Bench::threadIndex()));
 
 struct stats {
 	int successfull = 0;
@@ -42,109 +41,72 @@ struct stats {
 };
 
 void setup(int argc, char ** argv);
-void threadFunc(stats & threadStats, boost::barrier * b);
-void printStats(stats & s);
+Bench::Metrics metrics(const stats & s, double seconds, const Bench::PerfCounts & events);
+void printStats(stats & s, double seconds);
 void makeSomeTransaction(stats & threadStats);
 void initVars();
 void finalChecks();
 void freeVars();
-void run();
+void run(const char * label);
 
 int main(int argc, char ** argv){
 	
 	setup(argc, argv);
 	
-	printf("\nRevocable:\n");
-	
 	initVars();
 	
-	run();
+	run("Revocable");
 	
 	freeVars();
 	
 	irr = true;
 	
-	printf("\nIrrevocable:\n");
-	
 	initVars();
 	
-	run();
+	run("Irrevocable");
 	
 	freeVars();
 	
+	driver.finish();
+	
 	return 0;
 }
 
-void run(){
-	vector<boost::thread> threads;
-	vector<stats> threadStats(threadNo);
-	
-	boost::barrier threadBarrier(threadNo+1);
-	
-	for(int i = 0 ; i < threadNo; ++i){
-		threads.push_back(boost::thread(threadFunc, ref(threadStats[i]), &threadBarrier));
-	}
-	
-	auto sleepTime = boost::chrono::seconds(timeSecs);
-	threadBarrier.wait();
-	boost::this_thread::sleep_for(sleepTime);
-	for(boost::thread & t: threads)
-		t.interrupt();
-	for(boost::thread & t: threads)
-		t.join();
-	
-	atomic_thread_fence(memory_order_seq_cst);
-	
-	
-	stats finalStats;
-	for(int i = 0 ; i < threadNo; ++i)
-		finalStats += threadStats[i];
+void run(const char * label){
+	Bench::Outcome<stats> outcome = driver.run<stats>(label, makeSomeTransaction, metrics);
 	
 	finalChecks();
 	
-	printStats(finalStats);
+	printStats(outcome.total, outcome.seconds);
 }
 
 void setup(int argc, char ** argv){
-	boost::program_options::options_description opts;
-	opts.add_options()
-		("seconds,s", boost::program_options::value<int>(&timeSecs)->default_value( 1), "Benchmark length in seconds")
-		("vars,v", boost::program_options::value<int>(&varsNo)->default_value(1024), "Number of variables")
-		("transfers,w", boost::program_options::value<int>(&transfersPerTransaction)->default_value(10), "Transfers per transaction (1 × read + 2 × write)")
-		("reads,r", boost::program_options::value<int>(&readsPerTransaction)->default_value(70), "Reads per transaction")
-		("help,h", "this help")
-	;
-	
-	boost::program_options::variables_map vm;
-	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, opts), vm);
-	boost::program_options::notify(vm);
-	
-	if (vm.count("help")) {
-		cout << opts << "\n";
-		exit(0);
-	}
-	
-	if(varsNo < 2 || timeSecs < 1 || transfersPerTransaction < 0 || readsPerTransaction < 0 
+	Bench::Options opts;
+	driver.addOptions(opts, 1);
+	opts.add("vars", 'v', varsNo, 1024, "Number of variables")
+	    .add("transfers", 'w', transfersPerTransaction, 10, "Transfers per transaction (1 × read + 2 × write)")
+	    .add("reads", 'r', readsPerTransaction, 70, "Reads per transaction");
+	opts.parse(argc, argv);
+	
+	if(!driver.setup(opts) || varsNo < 2 || transfersPerTransaction < 0 || readsPerTransaction < 0 
 		|| transfersPerTransaction + readsPerTransaction < 1 || readsPerTransaction > varsNo){
 		printf("Stupid arguments detected. Be gone!\n");
 		exit(1);
 	}
 	
-	printf("Seconds: %d\nVars: %d\nTransfers/transaction %d\nReads/transaction %d\n",
-		       timeSecs,   varsNo,  transfersPerTransaction,  readsPerTransaction);
+	printf("Threads: %d\nSeconds: %g × %d (after %g s warmup)\nVars: %d\nTransfers/transaction %d\nReads/transaction %d\n",
+		       driver.threads, driver.seconds, driver.repetitions, driver.warmupSecs, varsNo,  transfersPerTransaction,  readsPerTransaction);
 }
 
-void threadFunc(stats & threadStats, boost::barrier * b){
-	b->wait();
-	
-	while(true){
-		makeSomeTransaction(threadStats);
-		boost::this_thread::interruption_point();
-	}
+Bench::Metrics metrics(const stats & s, double seconds, const Bench::PerfCounts & events){
+	Bench::Metrics m {{"commits/s", s.successfull / seconds}, {"aborts/s", s.aborted / seconds}};
+	events.normalized(m, "commit", s.successfull);
+	return m;
 }
 
-void printStats(stats& s){
-	printf("Successfull: %d tx total, %f tx/s\n", s.successfull, s.successfull/double(timeSecs));
+void printStats(stats& s, double seconds){
+	printf("Successfull: %d tx total, %f tx/s\n", s.successfull, s.successfull/seconds);
+	printf("Aborted: %d tx total, %f tx/s\n", s.aborted, s.aborted/seconds);
 }
 
 //////////////////////////////
@@ -215,14 +177,10 @@ void makeSomeTransaction(stats & threadStats){
 	list<transferDescr> transfers = generateTransfers();
 	vector<Tm::Variable<int>*> reads = generateReads();
 	
-	TransResult res = runTransaction(transfers, reads, threadStats);
-	switch(res){
-		case TransResult::Success:
-			threadStats.successfull++;
-			return;
-		case TransResult::Abort:
-			throw "‽";
-	}
+	// with more than one thread transactions conflict; retry the same one until it commits
+	while(runTransaction(transfers, reads, threadStats) == TransResult::Abort)
+		threadStats.aborted++;
+	threadStats.successfull++;
 }
 
 
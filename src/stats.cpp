@@ -0,0 +1,100 @@
+#include "tmapi.h"
+#include "stats.h"
+#include "transaction.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace Tm {
+
+namespace {
+
+/// what stats() subtracts, i.e. the totals as of the last resetStats()
+Stats baseline;
+mutex baselineMutex;
+
+/*anonymous namespace end*/}
+
+const char * abortReasonName(AbortReason reason) {
+	switch(reason) {
+		case AbortReason::explicitAbort:        return "explicit";
+		case AbortReason::readDirty:            return "readDirty";
+		case AbortReason::readKilled:           return "readKilled";
+		case AbortReason::writeIrr:             return "writeIrr";
+		case AbortReason::writeLocked:          return "writeLocked";
+		case AbortReason::writeIrrLate:         return "writeIrrLate";
+		case AbortReason::writeKilled:          return "writeKilled";
+		case AbortReason::irrWaitKilled:        return "irrWaitKilled";
+		case AbortReason::irrReadsetLocked:     return "irrReadsetLocked";
+		case AbortReason::irrKilled:            return "irrKilled";
+		case AbortReason::commitKilled:         return "commitKilled";
+		case AbortReason::commitReadsetLost:    return "commitReadsetLost";
+		case AbortReason::commitStopped:        return "commitStopped";
+		case AbortReason::readOnlyCommitKilled: return "readOnlyCommitKilled";
+		case AbortReason::count:                break;
+	}
+	return "?";
+}
+
+Stats Stats::operator - (const Stats & earlier) const {
+	Stats d = *this;
+	d.begins -= earlier.begins;
+	d.commits -= earlier.commits;
+	d.aborts -= earlier.aborts;
+	for(unsigned i = 0 ; i < unsigned(AbortReason::count); ++i)
+		d.abortsBy[i] -= earlier.abortsBy[i];
+	d.irrevocable -= earlier.irrevocable;
+	d.irrWaitNs -= earlier.irrWaitNs;
+	d.hijacks -= earlier.hijacks;
+	d.readSetEntries -= earlier.readSetEntries;
+	d.writeSetEntries -= earlier.writeSetEntries;
+	d.killedReaders -= earlier.killedReaders;
+	return d;
+}
+
+Stats & Stats::operator += (const Stats & other) {
+	begins += other.begins;
+	commits += other.commits;
+	aborts += other.aborts;
+	for(unsigned i = 0 ; i < unsigned(AbortReason::count); ++i)
+		abortsBy[i] += other.abortsBy[i];
+	irrevocable += other.irrevocable;
+	irrWaitNs += other.irrWaitNs;
+	irrWaitMaxNs = max(irrWaitMaxNs, other.irrWaitMaxNs);
+	hijacks += other.hijacks;
+	readSetEntries += other.readSetEntries;
+	writeSetEntries += other.writeSetEntries;
+	killedReaders += other.killedReaders;
+	return *this;
+}
+
+void ThreadStats::addTo(Stats & s) const {
+	s.begins += begins.load(memory_order_relaxed);
+	s.commits += commits.load(memory_order_relaxed);
+	for(unsigned i = 0 ; i < unsigned(AbortReason::count); ++i){
+		uint64_t a = abortsBy[i].load(memory_order_relaxed);
+		s.abortsBy[i] += a;
+		s.aborts += a;
+	}
+	s.irrevocable += irrevocable.load(memory_order_relaxed);
+	s.irrWaitNs += irrWaitNs.load(memory_order_relaxed);
+	s.irrWaitMaxNs = max(s.irrWaitMaxNs, irrWaitMaxNs.load(memory_order_relaxed));
+	s.hijacks += hijacks.load(memory_order_relaxed);
+	s.readSetEntries += readSetEntries.load(memory_order_relaxed);
+	s.writeSetEntries += writeSetEntries.load(memory_order_relaxed);
+	s.killedReaders += killedReaders.load(memory_order_relaxed);
+}
+
+Stats stats() {
+	Stats total = Transaction::statsOfAllSlots();
+	lock_guard<mutex> lock(baselineMutex);
+	return total - baseline;
+}
+
+void resetStats() {
+	Stats total = Transaction::statsOfAllSlots();
+	lock_guard<mutex> lock(baselineMutex);
+	baseline = total;
+}
+
+/*namespace TM end*/}
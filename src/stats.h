@@ -0,0 +1,116 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "layout.h"
+
+using namespace std;
+
+namespace Tm {
+
+/// why a transaction got aborted
+enum class AbortReason : unsigned {
+	/// abortT() called by the user (or the thread exited within a transaction)
+	explicitAbort,
+	/// read: the variable is being committed by somebody else
+	readDirty,
+	/// read: a writer killed the transaction meanwhile
+	readKilled,
+	/// write: the variable is used by the irrevocable transaction
+	writeIrr,
+	/// write: somebody else holds the lock
+	writeLocked,
+	/// write: the irrevocable transaction took the variable right after we locked it
+	writeIrrLate,
+	/// write: a writer killed the transaction meanwhile (or the irrevocable one stopped it)
+	writeKilled,
+	/// irrT(): killed while waiting in line for irrevocability
+	irrWaitKilled,
+	/// irrT(): a variable read before is locked by somebody else
+	irrReadsetLocked,
+	/// irrT(): killed by a writer or the irrevocable transaction right before becoming irrevocable
+	irrKilled,
+	/// commit: a writer killed the transaction before it started committing
+	commitKilled,
+	/// commit: a writer killed the transaction while it was committing
+	commitReadsetLost,
+	/// commit: the irrevocable transaction stopped the transaction while it was committing
+	commitStopped,
+	/// commit of a transaction that wrote nothing: a writer killed it
+	readOnlyCommitKilled,
+	count
+};
+
+/// \returns a short name of reason, e.g. "readDirty"
+const char * abortReasonName(AbortReason reason);
+
+/// counters of all threads summed up, see Tm::stats()
+struct Stats {
+	uint64_t begins = 0;
+	uint64_t commits = 0;
+	uint64_t aborts = 0;
+	uint64_t abortsBy[unsigned(AbortReason::count)] = {};
+
+	/// transactions that became irrevocable, and the time they waited in line for it
+	uint64_t irrevocable = 0;
+	uint64_t irrWaitNs = 0;
+	uint64_t irrWaitMaxNs = 0;
+
+	/// write buffers the irrevocable transaction took over from committing transactions
+	uint64_t hijacks = 0;
+
+	/// read and write set entries of all finished (committed or aborted) transactions
+	uint64_t readSetEntries = 0;
+	uint64_t writeSetEntries = 0;
+
+	/// running transactions killed by committing writers, counted by the writers
+	uint64_t killedReaders = 0;
+
+	/// \returns counters of this minus those of earlier (maxima are left as they are)
+	Stats operator - (const Stats & earlier) const;
+
+	Stats & operator += (const Stats & other);
+};
+
+/**
+ * \brief Counters of one thread slot.
+ *
+ * Only the thread owning the slot writes them, with plain load-add-store, so the counters cost no
+ * atomic read-modify-write and no cache line bouncing; Tm::stats() reads them from any thread.
+ * Padded on both sides, so that the descriptor fields around them do not share their lines.
+ */
+struct ThreadStats {
+	/// adds n to own counter c
+	static void bump(atomic<uint64_t> & c, uint64_t n = 1) {
+		c.store(c.load(memory_order_relaxed) + n, memory_order_relaxed);
+	}
+
+	char padBefore[cacheLineSize];
+
+	atomic<uint64_t> begins {0};
+	atomic<uint64_t> commits {0};
+	atomic<uint64_t> abortsBy[unsigned(AbortReason::count)];
+	atomic<uint64_t> irrevocable {0};
+	atomic<uint64_t> irrWaitNs {0};
+	atomic<uint64_t> irrWaitMaxNs {0};
+	atomic<uint64_t> hijacks {0};
+	atomic<uint64_t> readSetEntries {0};
+	atomic<uint64_t> writeSetEntries {0};
+	atomic<uint64_t> killedReaders {0};
+
+	char padAfter[cacheLineSize];
+
+	ThreadStats() {
+		for(auto & a : abortsBy)
+			a.store(0, memory_order_relaxed);
+	}
+
+	/// adds the counters to s
+	void addTo(Stats & s) const;
+};
+
+/*namespace TM end*/}
+
+#endif // STATS_H
@@ -0,0 +1,454 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "transaction.h"
+#include "pool.h"
+
+using namespace std;
+
+namespace Tm {
+
+/**
+ * \brief Tells if values of T are kept inline, in one atomic word, rather than behind a shared_ptr.
+ *
+ * Trivially copyable values of up to 8 bytes qualify. Anything wider would need a double-width CAS,
+ * which C++11 does not promise to be lock-free.
+ */
+template <typename T>
+struct storedInline : integral_constant<bool,
+	is_trivially_copyable<T>::value && sizeof(T) <= sizeof(uint64_t) && alignof(T) <= alignof(uint64_t)> {};
+
+/**
+ * \brief Opt-in for large values: specialize as true_type, and reads of Variable\<T\> share an immutable snapshot
+ * of the value instead of copying it (see SnapshotStorage).
+ *
+ * E.g. template <> struct Tm::sharedSnapshots<vector<Order>> : true_type {};
+ */
+template <typename T>
+struct sharedSnapshots : false_type {};
+
+/**
+ * \brief The global copy of a variable, and the buffers transactions keep for it.
+ *
+ * What read and write buffers are, and how commit makes a write buffer the global copy, depends on the variant.
+ * A read buffer becomes the write buffer when the transaction goes on to write the variable (upgrade), so that
+ * references handed out by ro() see what is written through rw() - except for shared snapshots, which are immutable.
+ * 
+ * A readGlobal / writeGlobal that returns nullptr means that the global copy has just been replaced;
+ * whoever replaced it has aborted the caller already.
+ */
+template <typename T, bool = storedInline<T>::value>
+class ValueStorage;
+
+template <typename T>
+class SnapshotStorage;
+
+/// the storage Variable\<T\> uses
+template <typename T>
+struct StorageOf {
+	typedef typename conditional<sharedSnapshots<T>::value, SnapshotStorage<T>, ValueStorage<T>>::type type;
+};
+
+/**
+ * \brief General case: the global copy lives on the heap, and commit replaces the shared_ptr to it.
+ *
+ * A write buffer is a shared_ptr to the new value, so that an irrevocable transaction hijacking
+ * the buffer from a committing owner can keep it alive and write to it.
+ */
+template <typename T>
+class ValueStorage<T, false> {
+public:
+	typedef shared_ptr<T> WriteBuffer;
+	/// a write buffer, so that it can be upgraded in place
+	typedef WriteBuffer ReadBuffer;
+
+	ValueStorage() : varPtr(make_shared<T>()) {}
+
+	explicit ValueStorage(const T & val) : varPtr(make_shared<T>(val)) {}
+
+	/// the global copy itself; for non-transactional access only
+	T * global() {return varPtr.get();}
+
+	/// creates a read buffer holding a copy of the global copy
+	ReadBuffer * readGlobal(Transaction * ctb) {
+		return newWriteBuffer(ctb, *varPtr);
+	}
+
+	static T * readValue(ReadBuffer * buffer) {
+		return buffer->get();
+	}
+
+	/// \returns the write buffer that read buffer becomes
+	static WriteBuffer * upgrade(Transaction *, ReadBuffer * buffer) {
+		return buffer;
+	}
+
+	/// creates a write buffer holding a copy of the global copy
+	WriteBuffer * writeGlobal(Transaction * ctb) {
+		return newWriteBuffer(ctb, *varPtr);
+	}
+
+	/// creates a write buffer holding a copy of val; the value itself comes from the pool, as it may become varPtr
+	static WriteBuffer * newWriteBuffer(Transaction * ctb, const T & val) {
+		return ctb->arena.create<WriteBuffer>(allocate_shared<T>(PoolAllocator<T>(), val));
+	}
+
+	static T * valueOf(WriteBuffer * buffer) {
+		return buffer->get();
+	}
+
+	/// called by irrevocable ctb when it takes over buffer of the committing transaction owner; \returns AccessEntry::hijackedBuffer
+	static void * hijack(Transaction * ctb, WriteBuffer * buffer, TxRef /* owner */) {
+		// we must keep track of the buffer, and we must properly keep track of its use count as well
+		return ctb->arena.create<WriteBuffer>(*buffer);
+	}
+
+	/// makes buffer the global copy
+	void write(Transaction *, WriteBuffer * buffer) {
+		varPtr = *buffer;
+	}
+
+	/// makes buffer the global copy; the buffer hijacked (if any) gets the same value
+	void writeAsIrr(Transaction *, WriteBuffer * buffer, void * hijacked) {
+		// now... if there is a hijacked transaction...
+		if(hijacked){
+			WriteBuffer * hijackedBuffer = (WriteBuffer*) hijacked;
+			**hijackedBuffer = **buffer;
+
+			varPtr = *hijackedBuffer;
+		} else {
+			// I have the most recent value, so acquire fence is not needed here
+			varPtr = *buffer;
+		}
+	}
+
+protected:
+	/// the real variable
+	shared_ptr<T> varPtr;
+};
+
+/**
+ * \brief Small trivially copyable values: the global copy is an atomic word, and commit is a store.
+ *
+ * A write buffer is a word in the arena that holds the T (zero-padded). Nothing is reference counted,
+ * nothing goes to the heap.
+ *
+ * Hijacking is the tricky part. The owner copies its buffer to the variable, so the irrevocable transaction
+ * can't just overwrite the buffer as in the general case - the owner might have copied it already and
+ * might still store the old contents afterwards. So the irrevocable transaction writes its value to
+ * the buffer of the owner and then to the variable, while the owner stores its buffer to the variable
+ * and then checks if the buffer changed meanwhile, storing again if so. All of it is seq_cst, so
+ * whichever store comes last, it stores the irrevocable value (and the owner stores at most twice).
+ */
+template <typename T>
+class ValueStorage<T, true> {
+public:
+	typedef uint64_t WriteBuffer;
+	/// a whole word, so that it can be upgraded in place
+	typedef WriteBuffer ReadBuffer;
+
+	ValueStorage() : word(toWord(T())) {}
+
+	explicit ValueStorage(const T & val) : word(toWord(val)) {}
+
+	/// the global copy itself; for non-transactional access only
+	T * global() {return (T*) &word;}
+
+	/// creates a read buffer holding a copy of the global copy
+	ReadBuffer * readGlobal(Transaction * ctb) {
+		return ctb->arena.create<ReadBuffer>(word.load(memory_order_relaxed));
+	}
+
+	static T * readValue(ReadBuffer * buffer) {
+		// trivially copyable - the word is the storage of the T
+		return (T*) buffer;
+	}
+
+	/// \returns the write buffer that read buffer becomes
+	static WriteBuffer * upgrade(Transaction *, ReadBuffer * buffer) {
+		return buffer;
+	}
+
+	/// creates a write buffer holding a copy of the global copy
+	WriteBuffer * writeGlobal(Transaction * ctb) {
+		return ctb->arena.create<WriteBuffer>(word.load(memory_order_relaxed));
+	}
+
+	/// creates a write buffer holding a copy of val
+	static WriteBuffer * newWriteBuffer(Transaction * ctb, const T & val) {
+		return ctb->arena.create<WriteBuffer>(toWord(val));
+	}
+
+	static T * valueOf(WriteBuffer * buffer) {
+		// the word is the storage of the T that rw() hands out
+		return (T*) buffer;
+	}
+
+	/// called by irrevocable ctb when it takes over buffer of the committing transaction owner; \returns AccessEntry::hijackedBuffer
+	static void * hijack(Transaction * ctb, WriteBuffer * buffer, TxRef owner) {
+		// the buffer belongs to the arena of the owner, so until our commit we only remember where it was
+		return ctb->arena.create<Hijacked>(Hijacked{buffer, owner});
+	}
+
+	/// makes buffer the global copy, unless an irrevocable transaction hijacked it (see class description)
+	void write(Transaction *, WriteBuffer * buffer) {
+		uint64_t value = __atomic_load_n(buffer, __ATOMIC_SEQ_CST);
+		word.store(value, memory_order_seq_cst);
+
+		uint64_t again;
+		while((again = __atomic_load_n(buffer, __ATOMIC_SEQ_CST)) != value){
+			value = again;
+			word.store(value, memory_order_seq_cst);
+		}
+	}
+
+	/// makes buffer the global copy; the buffer hijacked (if any) gets the same value
+	void writeAsIrr(Transaction *, WriteBuffer * buffer, void * hijacked) {
+		uint64_t value = *buffer;
+
+		if(hijacked){
+			Hijacked * h = (Hijacked*) hijacked;
+			// the buffer is there only while the owner has not finished; once it has, it is done with storing
+			Transaction * owner = Transaction::descriptor(h->owner);
+			if(owner->protect(h->owner)){
+				__atomic_store_n(h->buffer, value, __ATOMIC_SEQ_CST);
+				word.store(value, memory_order_seq_cst);
+				Transaction::unprotect();
+				return;
+			}
+		}
+
+		word.store(value, memory_order_relaxed);
+	}
+
+protected:
+	/// the real variable
+	atomic<uint64_t> word;
+
+	/// what an irrevocable transaction remembers about a hijacked buffer
+	struct Hijacked {
+		WriteBuffer * buffer;
+		TxRef owner;
+	};
+
+	static uint64_t toWord(const T & val) {
+		uint64_t w = 0;
+		memcpy(&w, &val, sizeof(T));
+		return w;
+	}
+};
+
+/// value shared by the global copy and any number of readers; freed once the last reference is released
+class SharedSnapshot {
+public:
+	SharedSnapshot() = default;
+
+	SharedSnapshot(const SharedSnapshot &) = delete;
+
+	virtual ~SharedSnapshot() {}
+
+	void retain() {
+		refs.fetch_add(1, memory_order_relaxed);
+	}
+
+	void release() {
+		if(refs.fetch_sub(1, memory_order_acq_rel) == 1)
+			delete this;
+	}
+
+protected:
+	/// the creator holds the first reference
+	atomic<long> refs {1};
+};
+
+template <typename T>
+struct Snapshot : public SharedSnapshot {
+	Snapshot() : value() {}
+
+	explicit Snapshot(const T & val) : value(val) {}
+
+	/// mutable only before it is published
+	T value;
+};
+
+/**
+ * \brief Opt-in (see sharedSnapshots) storage for large values: reads share the global copy instead of copying it.
+ *
+ * The global copy is an immutable, reference counted Snapshot. A read takes a reference to it, so it costs
+ * the same for 8 bytes and for 8 megabytes. A write copies the value into a new snapshot, which commit
+ * publishes (copy-on-write).
+ *
+ * Taking a reference races with a commit that replaces the snapshot and drops it. So the reader announces
+ * the snapshot in its descriptor (snapshotHazard) and checks that it is still current before touching its
+ * counter, while a commit hands replaced snapshots to its descriptor, which releases them only once no
+ * thread announces them (a hazard pointer scheme, see Transaction::releaseRetiredSnapshots).
+ *
+ * Hijacking works as for inline values, with snapshot pointers in place of words: the owner publishes
+ * whatever its buffer says, until it stops changing, and the irrevocable transaction changes it first.
+ */
+template <typename T>
+class SnapshotStorage {
+public:
+	/// a snapshot to be published, and the snapshot the commit actually publishes (see class description)
+	struct WriteBuffer {
+		Snapshot<T> * mine;
+		atomic<Snapshot<T>*> toPublish;
+
+		explicit WriteBuffer(Snapshot<T> * snapshot) : mine(snapshot), toPublish(snapshot) {}
+
+		~WriteBuffer() {
+			// the irrevocable transaction retained its snapshot for us
+			Snapshot<T> * other = toPublish.load(memory_order_relaxed);
+			if(other != mine)
+				other->release();
+			mine->release();
+		}
+	};
+
+	SnapshotStorage() : current(new Snapshot<T>()) {}
+
+	explicit SnapshotStorage(const T & val) : current(new Snapshot<T>(val)) {}
+
+	SnapshotStorage(const SnapshotStorage &) = delete;
+
+	~SnapshotStorage() {
+		current.load(memory_order_relaxed)->release();
+	}
+
+	/// the global copy itself; for non-transactional access only
+	T * global() {return &current.load(memory_order_acquire)->value;}
+
+	/// the shared snapshot value itself
+	typedef T ReadBuffer;
+
+	/// \returns the global copy, which stays valid till the end of the transaction; nullptr if it has just been replaced
+	ReadBuffer * readGlobal(Transaction * ctb) {
+		Snapshot<T> * snapshot = acquire(ctb);
+		if(!snapshot)
+			return nullptr;
+		// the reference is released with the arena
+		ctb->arena.create<Reference>(snapshot);
+		return &snapshot->value;
+	}
+
+	static T * readValue(ReadBuffer * buffer) {
+		return buffer;
+	}
+
+	/// \returns a write buffer holding a copy of the read one; snapshots are shared, so they can't be written in place
+	static WriteBuffer * upgrade(Transaction * ctb, ReadBuffer * buffer) {
+		return newWriteBuffer(ctb, *buffer);
+	}
+
+	/// creates a write buffer holding a copy of the global copy; nullptr if it has just been replaced
+	WriteBuffer * writeGlobal(Transaction * ctb) {
+		Snapshot<T> * snapshot = acquire(ctb);
+		if(!snapshot)
+			return nullptr;
+		WriteBuffer * buffer = newWriteBuffer(ctb, snapshot->value);
+		snapshot->release();
+		return buffer;
+	}
+
+	/// creates a write buffer holding a copy of val
+	static WriteBuffer * newWriteBuffer(Transaction * ctb, const T & val) {
+		return ctb->arena.create<WriteBuffer>(new Snapshot<T>(val));
+	}
+
+	static T * valueOf(WriteBuffer * buffer) {
+		return &buffer->mine->value;
+	}
+
+	/// called by irrevocable ctb when it takes over buffer of the committing transaction owner; \returns AccessEntry::hijackedBuffer
+	static void * hijack(Transaction * ctb, WriteBuffer * buffer, TxRef owner) {
+		return ctb->arena.create<Hijacked>(Hijacked{buffer, owner});
+	}
+
+	/// publishes buffer, unless an irrevocable transaction hijacked it (see class description)
+	void write(Transaction * ctb, WriteBuffer * buffer) {
+		Snapshot<T> * snapshot = buffer->toPublish.load(memory_order_seq_cst);
+		publish(ctb, snapshot);
+
+		Snapshot<T> * again;
+		while((again = buffer->toPublish.load(memory_order_seq_cst)) != snapshot){
+			snapshot = again;
+			publish(ctb, snapshot);
+		}
+	}
+
+	/// publishes buffer; the buffer hijacked (if any) is made to publish it as well
+	void writeAsIrr(Transaction * ctb, WriteBuffer * buffer, void * hijacked) {
+		Snapshot<T> * snapshot = buffer->mine;
+
+		if(hijacked){
+			Hijacked * h = (Hijacked*) hijacked;
+			Transaction * owner = Transaction::descriptor(h->owner);
+			if(owner->protect(h->owner)){
+				// for the buffer of the owner, which outlives ours
+				snapshot->retain();
+				Snapshot<T> * previous = h->buffer->toPublish.exchange(snapshot, memory_order_seq_cst);
+				// an earlier irrevocable transaction retained that one for the buffer as well
+				if(previous && previous != snapshot && previous != h->buffer->mine)
+					previous->release();
+				publish(ctb, snapshot);
+				Transaction::unprotect();
+				return;
+			}
+		}
+
+		publish(ctb, snapshot);
+	}
+
+protected:
+	/// the real variable
+	atomic<Snapshot<T>*> current;
+
+	/// what an irrevocable transaction remembers about a hijacked buffer
+	struct Hijacked {
+		WriteBuffer * buffer;
+		TxRef owner;
+	};
+
+	/// reference held by a read buffer
+	struct Reference {
+		Snapshot<T> * snapshot;
+
+		explicit Reference(Snapshot<T> * snapshot) : snapshot(snapshot) {}
+
+		~Reference() {
+			snapshot->release();
+		}
+	};
+
+	/// takes a reference to the global copy; nullptr if it was replaced meanwhile
+	Snapshot<T> * acquire(Transaction * ctb) {
+		Snapshot<T> * snapshot = current.load(memory_order_acquire);
+		ctb->snapshotHazard.store(snapshot, memory_order_seq_cst);
+		if(current.load(memory_order_seq_cst) != snapshot){
+			// someone committed in the meantime, and that someone has killed us by now
+			ctb->snapshotHazard.store(nullptr, memory_order_relaxed);
+			return nullptr;
+		}
+		snapshot->retain();
+		ctb->snapshotHazard.store(nullptr, memory_order_release);
+		return snapshot;
+	}
+
+	void publish(Transaction * ctb, Snapshot<T> * snapshot) {
+		// one reference per publication, dropped when the global copy moves on
+		snapshot->retain();
+		Snapshot<T> * old = current.exchange(snapshot, memory_order_seq_cst);
+		// a reader may be taking a reference to the old one right now
+		ctb->retiredSnapshots.push_back(old);
+	}
+};
+
+/*namespace TM end*/}
+
+#endif // STORAGE_H
@@ -0,0 +1,191 @@
+#include "tmapi.h"
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+
+/*
+ * Stripe count sweep: how many ownership records variables need.
+ *
+ * Threads run transactions that each do a few random transfers over many variables,
+ * so real conflicts are rare and whatever aborts show up come mostly from variables
+ * sharing an Orec. The run is repeated for each stripe count, from minStripes to
+ * maxStripes; the table can be sized only once per process, so each run is a child process.
+ *
+ * Built with per-variable metadata there is nothing to sweep; then it does a single
+ * run for reference.
+ */
+
+// benchmark parameters:
+int threads;
+int varsNo;
+int transfers;
+int duration;
+long long minStripes;
+long long maxStripes;
+int factor;
+
+const int initialValue = 100;
+
+void setup(int argc, char ** argv);
+
+struct alignas(Tm::cacheLineSize) Counters {
+	long long commits = 0;
+	long long aborts = 0;
+};
+
+/// \returns false if the sum of all variables is broken
+bool run(const char * label, size_t metadataBytes){
+	vector<Tm::Variable<int>*> vars;
+	for(int i = 0 ; i < varsNo; ++i)
+		vars.push_back(new Tm::Variable<int>(initialValue));
+
+	// no irrevocability - aborts are what we're after
+	Tm::ExponentialBackoff backoff;
+	Tm::RetryPolicy policy;
+	policy.contentionManager = &backoff;
+	policy.sizeHint = 2 * transfers;
+
+	atomic<bool> stop {false};
+	vector<Counters> counters(threads);
+	vector<thread> workers;
+
+	for(int i = 0 ; i < threads; ++i)
+		workers.emplace_back([&, i](){
+			default_random_engine generator(i);
+			uniform_int_distribution<> varDist(0, varsNo-1);
+			vector<int> picks(2 * transfers);
+			while(!stop.load(memory_order_relaxed)){
+				for(auto & p : picks)
+					p = varDist(generator);
+				Tm::atomically([&](){
+					for(int t = 0 ; t < transfers; ++t){
+						Tm::Variable<int> & from = *vars[picks[2*t]];
+						Tm::Variable<int> & to = *vars[picks[2*t+1]];
+						const int * balance = from.tryRo();
+						if(!balance)
+							return false;
+						if(*balance <= 0)
+							continue;
+						int * f = from.tryRw();
+						if(!f)
+							return false;
+						--*f;
+						int * d = to.tryRw();
+						if(!d)
+							return false;
+						++*d;
+					}
+					return true;
+				}, policy);
+			}
+			counters[i].commits = Tm::abortHistory().commits;
+			counters[i].aborts = Tm::abortHistory().aborts;
+		});
+
+	this_thread::sleep_for(chrono::milliseconds(duration));
+	stop = true;
+	for(auto & w : workers)
+		w.join();
+
+	long long commits = 0, aborts = 0;
+	for(auto & c : counters){
+		commits += c.commits;
+		aborts += c.aborts;
+	}
+
+	long long endSum = 0;
+	Tm::beginT();
+	for(auto v : vars)
+		endSum += v->ro();
+	Tm::commitT();
+
+	for(auto v : vars)
+		delete v;
+
+	printf("%12s %12.1f %14.0f %16.4f\n", label, metadataBytes / 1048576.0, commits * 1000.0 / duration, commits ? double(aborts) / commits : 0.0);
+
+	return endSum == (long long) initialValue * varsNo;
+}
+
+int main(int argc, char ** argv){
+	setup(argc, argv);
+
+	printf("%12s %12s %14s %16s\n", "stripes", "metadata MB", "commits/s", "aborts/commit");
+
+	bool fine = true;
+
+#if TM_METADATA == TM_METADATA_STRIPED
+	for(long long stripes = minStripes ; stripes <= maxStripes; stripes *= factor){
+		// or the child prints the header once again
+		fflush(stdout);
+
+		pid_t child = fork();
+		if(child < 0){
+			perror("fork");
+			return 1;
+		}
+		if(!child){
+			Tm::orecStripes = stripes;
+			bool ok = run(to_string(stripes).c_str(), stripes * sizeof(Tm::Orec));
+			fflush(stdout);
+			_exit(ok ? 0 : 1);
+		}
+
+		int status;
+		waitpid(child, &status, 0);
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			fine = false;
+	}
+#else
+	fine = run("per-var", (size_t) varsNo * sizeof(Tm::Orec));
+#endif
+
+	if(fine)
+		printf("All fine\n");
+	else
+		printf("TM problem - endSum!=varsSum\n");
+
+	return fine ? 0 : 1;
+}
+
+void setup(int argc, char ** argv){
+	boost::program_options::options_description opts;
+	opts.add_options()
+		("threads,t", boost::program_options::value<int>(&threads)->default_value(4), "Number of threads")
+		("vars,v", boost::program_options::value<int>(&varsNo)->default_value(1000000), "Number of variables")
+		("transfers,x", boost::program_options::value<int>(&transfers)->default_value(4), "Transfers per transaction")
+		("duration,d", boost::program_options::value<int>(&duration)->default_value(1000), "Duration of each run in ms")
+		("min-stripes,s", boost::program_options::value<long long>(&minStripes)->default_value(1), "Smallest stripe count")
+		("max-stripes,S", boost::program_options::value<long long>(&maxStripes)->default_value(1 << 22), "Largest stripe count")
+		("factor,f", boost::program_options::value<int>(&factor)->default_value(4), "Stripe count grows this many times between runs")
+		("help,h", "this help")
+	;
+
+	boost::program_options::variables_map vm;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, opts), vm);
+	boost::program_options::notify(vm);
+
+	if (vm.count("help")) {
+		cout << opts << "\n";
+		exit(0);
+	}
+
+	if(threads < 1 || (unsigned) threads >= Tm::maxThreadNum || varsNo < 2 || transfers < 1 || duration < 1 ||
+	   minStripes < 1 || maxStripes < minStripes || factor < 2){
+		printf("Stupid arguments detected. Be gone!\n");
+		exit(1);
+	}
+
+	printf("Threads: %d\nVariables: %d\nTransfers/transaction: %d\nDuration: %d ms\n", threads, varsNo, transfers, duration);
+}
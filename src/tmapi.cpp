@@ -24,14 +24,12 @@ bool checkIfCompilerCupportsWaitFree() {
 	return true;
 }
 
-// The line below is not neat :-(
-// But it's wait-free and fast, so…
+// upper bound for the number of theads running transactions at the same time
+unsigned int maxThreadNum = 64;
 
-// upper bound for the total number of theads over the whole application run
-unsigned int maxThreadNum = 32;
-atomic<unsigned int> threadIdSequencer;
-/// Thread id of this thread, equal to number of threads started before
-thread_local unsigned int threadId = threadIdSequencer.fetch_add(1, memory_order_relaxed);
+#if TM_METADATA == TM_METADATA_STRIPED
+size_t orecStripes = size_t(1) << 20;
+#endif
 
 
 function<void ()> nonTransAccess = [](){throw InvalidUseException(); };
@@ -40,16 +38,20 @@ function<void ()> forcingAbortOnIrr = [](){throw InvalidUseException(); };
 
 static const volatile bool checkIfCompilerCupportsWaitFree_ = checkIfCompilerCupportsWaitFree();
 
-/// \brief Stores the current transaction
-thread_local shared_ptr<Transaction> currentTransaction;
+/// \brief Stores the current transaction; nullptr outside transactions
+thread_local Transaction * currentTransaction = nullptr;
 
-void beginT() {
+void beginT(size_t sizeHint) {
+	beginT(ReadWrite, sizeHint);
+}
+
+void beginT(TxMode mode, size_t sizeHint) {
 	if(currentTransaction) {
 		// nesting? yuck!
 		throw InvalidUseException();
 	}
 	
-	currentTransaction.reset(new Transaction);
+	currentTransaction = Transaction::start(sizeHint, mode == ReadOnly);
 }
 
 
@@ -81,5 +83,40 @@ void commitT() {
 	currentTransaction->commit();
 }
 
+TxStatus tryIrrT() {
+	if(!currentTransaction) {
+		// wait, there is no transaction running in this thread!
+		throw InvalidUseException();
+	}
+	
+	return currentTransaction->tryIrr() ? TxStatus::ok : TxStatus::aborted;
+}
+
+TxStatus tryCommitT() {
+	if(!currentTransaction) {
+		// wait, there is no transaction running in this thread!
+		throw InvalidUseException();
+	}
+	
+	return currentTransaction->tryCommit() ? TxStatus::ok : TxStatus::aborted;
+}
+
+void abandonT() {
+	if(currentTransaction)
+		currentTransaction->rollBack(AbortReason::explicitAbort);
+}
+
+bool activeT() {
+	return currentTransaction != nullptr;
+}
+
+bool irrevocableT() {
+	return currentTransaction && currentTransaction->isIrrevocable();
+}
+
+bool queuedForIrrT() {
+	return currentTransaction && currentTransaction->queuedForIrr();
+}
+
 
 /*namespace TM end*/}
\ No newline at end of file
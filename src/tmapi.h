@@ -7,13 +7,46 @@
  **/
 
 #include <functional>
+#include <cstddef>
+#include <string>
+
+#include "conflicts.h"
+#include "contention.h"
+#include "layout.h"
+#include "stats.h"
 using namespace std;
 
 namespace Tm {
 	
-	/// Total maximum number of threads executing transactions; can be set only before variables are created
+	/**
+	 * \brief Maximum number of threads executing transactions at the same time; can be set only before variables are created
+	 * and before the first transaction
+	 * 
+	 * A thread takes a slot on its first transaction and gives it back on exit, so threads can come and go at will.
+	 * Each variable spends a bit per slot, so up to 64 slots cost nothing extra.
+	 */
 	extern unsigned int maxThreadNum;
 	
+#if TM_METADATA == TM_METADATA_STRIPED
+	/**
+	 * \brief Number of ownership records all variables share; rounded up to a power of two; can be set only before
+	 * variables are created
+	 * 
+	 * Variables are mapped onto records by address hash, and variables that share a record conflict as if they
+	 * were one. So more records mean fewer false conflicts, at the cost of memory that does not depend on
+	 * the number of variables. Default: 2^20.
+	 */
+	extern size_t orecStripes;
+#endif
+
+#if TM_EVENTS
+	/**
+	 * \brief Events each thread slot keeps for dumpEvents(), the newest ones; rounded up to a power of two; can be set
+	 * only before the first transaction. Each takes 16 bytes. Default: 2^16.
+	 */
+	extern size_t eventsPerSlot;
+#endif
+	
 	// exception tree
 	
 	/*       */ /// base class for all exceptions
@@ -33,14 +66,34 @@ namespace Tm {
 
 	/**
 	 * \brief Starts a new transaction in current thread
+	 * \param sizeHint expected number of distinct variables the transaction accesses (0 if unknown);
+	 *        lets the transaction allocate its read/write set once
+	 * \throws InvalidUseException if there already exists some transaction
+	 */
+	void beginT(size_t sizeHint = 0);
+	
+	/// what a transaction is going to do, see beginT(TxMode, size_t)
+	enum TxMode {ReadWrite, ReadOnly};
+	
+	/**
+	 * \brief Starts a new transaction in current thread, declaring if it is going to write
+	 * 
+	 * ReadOnly transactions read without looking for write buffers. Their first rw() (or irrT())
+	 * turns them into ordinary transactions, so a wrong guess costs nothing but the guess.
+	 * Independently of the mode, a transaction that wrote nothing commits by merely checking it is still alive.
+	 * 
 	 * \throws InvalidUseException if there already exists some transaction
 	 */
-	void beginT();
+	void beginT(TxMode mode, size_t sizeHint = 0);
 	
 	/**
 	 * \brief Transits current transaction to irrevocable state
 	 * \throws InvalidUseException if there is no transaction in current thread
-	 * \throws IrrevocTransException if the operation failed
+	 * \throws IrrevocTransException if the operation failed; the thread keeps its place in line for irrevocability
+	 *         (see queuedForIrrT) until it becomes irrevocable or commits
+	 * 
+	 * Waits while another transaction is irrevocable, or others wait in line before this one. Meanwhile the
+	 * transaction can be killed like any revocable one; then irrT() fails.
 	 */
 	void irrT();
 	
@@ -57,6 +110,124 @@ namespace Tm {
 	 */
 	void commitT();
 	
+	/**
+	 * Exception-free API
+	 * 
+	 * Conflicts are reported by return values: tryIrrT() / tryCommitT() return TxStatus::aborted, and
+	 * Variable::tryRo() / tryRw() return nullptr. In either case the transaction has been aborted already.
+	 * Exceptions are still thrown on invalid use (e.g. no transaction running), as that's a bug and not a conflict.
+	 * 
+	 * Both APIs can be freely mixed.
+	 */
+	
+	/// outcome of a transaction or of an operation in it
+	enum class TxStatus {ok, aborted};
+	
+	/// irrT() without exceptions
+	TxStatus tryIrrT();
+	
+	/// commitT() without exceptions
+	TxStatus tryCommitT();
+	
+	/// \returns if there is a transaction running in current thread
+	bool activeT();
+	
+	/// \returns if the transaction running in current thread is irrevocable (false if there is none)
+	bool irrevocableT();
+	
+	/**
+	 * \brief \returns if an earlier attempt of the transaction running in current thread failed to become irrevocable
+	 * (false if there is no transaction)
+	 * 
+	 * A failed irrT() / tryIrrT() leaves the thread its place in line for irrevocability. Checking this at the
+	 * beginning of a retry allows going irrevocable right away, before the retry gets killed the same way.
+	 */
+	bool queuedForIrrT();
+	
+	/**
+	 * \brief Aborts the transaction running in current thread, if any, when it cannot go on - irrevocable ones included,
+	 * without calling forcingAbortOnIrr: their writes are buffered as well, so nothing has been published yet
+	 */
+	void abandonT();
+	
+	/// tells Tm::atomically how to retry and when to give up
+	struct RetryPolicy {
+		static const unsigned int never = ~0u;
+		
+		/// backoff, irrevocability etc.; nullptr stands for defaultContentionManager()
+		ContentionManager * contentionManager = nullptr;
+		
+		/// after so many retries atomically gives up and returns TxStatus::aborted
+		unsigned int maxRetries = never;
+		
+		/// passed to beginT
+		TxMode mode = ReadWrite;
+		size_t sizeHint = 0;
+	};
+	
+	/**
+	 * \brief Runs fn in a transaction until it commits: begins, retries as the contention manager says, and commits.
+	 * 
+	 * fn takes no arguments and returns bool. It should use the exception-free API (tryRo / tryRw / tryIrrT)
+	 * and return false as soon as any of these fails; then the transaction is retried. Exceptions thrown
+	 * by the throwing API are understood as well, but they are way more expensive.
+	 * 
+	 * Inside fn, abortT() followed by return false means "retry", while return false with the transaction
+	 * still running means "give up": the transaction is aborted and atomically returns TxStatus::aborted.
+	 * That holds for irrevocable transactions too (see abandonT()), as does aborting on an exception out of fn.
+	 * 
+	 * \returns TxStatus::ok once committed, TxStatus::aborted if fn gave up or the policy ran out of retries
+	 */
+	template <typename F>
+	TxStatus atomically(F fn, const RetryPolicy & policy = RetryPolicy()) {
+		ContentionManager & manager = policy.contentionManager ? *policy.contentionManager : defaultContentionManager();
+		AbortHistory & history = abortHistory();
+		history.newTransaction();
+		
+		while(true) {
+			bool irrevocable = manager.beforeAttempt(history);
+			beginT(policy.mode, policy.sizeHint);
+			try {
+				// an earlier attempt waited in line for irrevocability and got killed meanwhile
+				irrevocable = irrevocable || queuedForIrrT();
+				if(!irrevocable || tryIrrT() == TxStatus::ok) {
+					if(fn()) {
+						if(tryCommitT() == TxStatus::ok) {
+							history.recordCommit();
+							manager.afterCommit(history);
+							return TxStatus::ok;
+						}
+					} else if(activeT()) {
+						// fn gave up
+						abandonT();
+						manager.afterGiveUp(history);
+						return TxStatus::aborted;
+					}
+				}
+				// else someone else is irrevocable
+			} catch(const InvalidUseException &) {
+				// a bug in fn, not a conflict
+				abandonT();
+				manager.afterGiveUp(history);
+				throw;
+			} catch(const TransactionException &) {
+				// thrown by the throwing API, which aborts the transaction before throwing
+			} catch(...) {
+				// not ours - the transaction can't go on
+				abandonT();
+				manager.afterGiveUp(history);
+				throw;
+			}
+			
+			history.recordAbort();
+			if(history.retry > policy.maxRetries) {
+				manager.afterGiveUp(history);
+				return TxStatus::aborted;
+			}
+			manager.afterAbort(history);
+		}
+	}
+	
 	/** 
 	 * \brief Function called whenever a variable is read or written to outside transaction. By default it throws an exception.
 	 */
@@ -67,6 +238,41 @@ namespace Tm {
 	 * By default it throws an exception.
 	 */
 	extern function<void ()> forcingAbortOnIrr;
+	
+	/**
+	 * \brief \returns counters of all threads, finished ones included, since the start of the program or the last resetStats()
+	 * 
+	 * Counters are always on: each thread bumps its own, so keeping them costs no synchronization. They are read
+	 * without stopping anybody, so the totals of running threads may be a few transactions off.
+	 */
+	Stats stats();
+	
+	/// makes stats() count from now on (except for irrWaitMaxNs, which is kept since the start)
+	void resetStats();
+	
+	/**
+	 * \brief Writes the events kept by all thread slots (see events.h) to file in Chrome trace format, which
+	 * chrome://tracing and Perfetto open: a track per slot, transactions as spans from begin to commit / abort,
+	 * and first reads / writes, irrevocability, kills and hijacks as instants within them.
+	 * 
+	 * Call it while no transactions run (e.g. after the benchmark); events recorded meanwhile may come out garbled.
+	 * \returns false if the library is built without TM_EVENTS, or if the file cannot be written
+	 */
+	bool dumpEvents(const string & file);
+	
+	/**
+	 * \brief \returns the n variables that cost the most transactions (aborts on touching them and readers killed by
+	 * commits writing them, see conflicts.h), most first, since the start of the program or the last resetConflicts()
+	 * 
+	 * Empty unless the library is built with TM_CONFLICTS. Logs are read under their locks, so it can be called any time.
+	 */
+	vector<VariableConflicts> conflictHotspots(size_t n);
+	
+	/// makes conflictHotspots() count from now on
+	void resetConflicts();
+	
+	/// gives var a name conflictHotspots() reports it under
+	void nameVariable(const VariableBase & var, const string & name);
 };
 
 /// definition of Variable template class
@@ -3,17 +3,240 @@
 #include "variable.h"
 
 #include <list>
+#include <algorithm>
+#include <mutex>
+#include <thread>
 
 namespace Tm {
 
 // initializing statics
-atomic_flag Transaction::irrTransactionLock{ATOMIC_FLAG_INIT};
+atomic<unsigned int> Transaction::irrToken{Transaction::noIrr};
+atomic<uint64_t> Transaction::irrTickets{0};
+atomic<TxRef> Transaction::irrHazard{0};
 
-Transaction::Transaction()
+namespace {
+
+/**
+ * Thread slots. A slot, together with its descriptor, belongs to one live thread at a time;
+ * it is taken on the first transaction of a thread and given back when the thread exits.
+ * So maxThreadNum limits threads running at the same time, not threads started over the whole run.
+ */
+struct SlotRegistry {
+	/// descriptors indexed by slot; created by the first thread in the slot, never freed
+	vector<atomic<Transaction*>> descriptors = vector<atomic<Transaction*>>(maxThreadNum);
+	
+	/// guards everything below; taking and releasing slots is not a transactional operation, so a mutex is fine
+	mutex slotsMutex;
+	
+	/// slots given back by finished threads
+	vector<unsigned int> freeSlots;
+	
+	/// slots from this one on have never been used
+	unsigned int nextSlot = 0;
+};
+
+SlotRegistry & registry() {
+	static SlotRegistry r;
+	return r;
+}
+
+thread_local Transaction * myDescriptor = nullptr;
+thread_local unsigned int mySlot;
+
+/// set once this thread gave its slot back at thread exit
+thread_local bool slotRetired = false;
+
+struct SlotGuard {
+	~SlotGuard() {
+		if(currentTransaction){
+			// the thread leaves in the middle of a transaction - it won't commit it anymore
+			currentTransaction->rollBack(AbortReason::explicitAbort);
+		}
+		
+		// or whoever queued up after us would wait forever
+		if(myDescriptor)
+			myDescriptor->leaveIrrLine();
+		
+		lock_guard<mutex> lock(registry().slotsMutex);
+		registry().freeSlots.push_back(mySlot);
+		myDescriptor = nullptr;
+		slotRetired = true;
+	}
+};
+
+/*anonymous namespace end*/}
+
+Transaction * Transaction::start(size_t sizeHint, bool readOnly)
+{
+	if(!myDescriptor)
+		myDescriptor = registerThread();
+	
+	myDescriptor->restart(sizeHint, readOnly);
+	return myDescriptor;
+}
+
+Transaction * Transaction::registerThread()
+{
+	if(slotRetired)
+		// thread is exiting
+		throw InvalidUseException();
+	
+	SlotRegistry & reg = registry();
+	{
+		lock_guard<mutex> lock(reg.slotsMutex);
+		if(!reg.freeSlots.empty()){
+			mySlot = reg.freeSlots.back();
+			reg.freeSlots.pop_back();
+		} else if(reg.nextSlot < reg.descriptors.size() && reg.nextSlot < (1u << slotBits)){
+			mySlot = reg.nextSlot++;
+		} else {
+			// more threads than Tm::maxThreadNum at once
+			throw InvalidUseException();
+		}
+	}
+	
+	// a reused slot comes with the descriptor of the previous thread, incarnations go on
+	Transaction * t = reg.descriptors[mySlot].load(memory_order_acquire);
+	if(!t){
+		t = new Transaction(mySlot);
+		reg.descriptors[mySlot].store(t, memory_order_release);
+	}
+	
+	// constructed here, so it is destroyed (and gives the slot back) on thread exit
+	static thread_local SlotGuard guard;
+	(void) guard;
+	
+	return t;
+}
+
+Transaction * Transaction::descriptor(TxRef ref)
+{
+	return descriptorOfSlot(ref & ((1u << slotBits) - 1));
+}
+
+Transaction * Transaction::descriptorOfSlot(unsigned int slot)
+{
+	return registry().descriptors[slot].load(memory_order_acquire);
+}
+
+Transaction::Transaction(unsigned int slot) : slot(slot), readerUnion(ReaderSet::wordsFor(maxThreadNum))
+#if TM_EVENTS
+	, events(eventsPerSlot)
+#endif
 {
 	// empty on purpose
 }
 
+void Transaction::restart(size_t sizeHint, bool readOnly)
+{
+	TxRef previous = myRef;
+	
+	// incarnations wrap around after 2^48 transactions; 0 is skipped, so that myRef is never 0
+	uint64_t incarnation = ((state.load(memory_order_relaxed) >> incarnationShift) + 1) & ((uint64_t(1) << (64 - slotBits)) - 1);
+	if(!incarnation)
+		incarnation = 1;
+	
+	// from now on nobody can kill, stop or protect the previous transaction; this also clears all flags
+	state.store(incarnation << incarnationShift, memory_order_seq_cst);
+	myRef = (incarnation << slotBits) | slot;
+	ThreadStats::bump(counters.begins);
+	trace(EventKind::begin, readOnly);
+#if TM_EVENTS
+	readTraced = writeTraced = false;
+#endif
+	amIIrrevocable = false;
+	this->readOnly = readOnly;
+	hasWrites = false;
+	
+	// buffers of the previous transaction can be freed, unless the irrevocable transaction is hijacking from it
+	TxRef hazard = irrHazard.load(memory_order_seq_cst);
+	
+	if(limboRef && hazard != limboRef){
+		limboArena.reset();
+		limboAccessSet->clear();
+		limboRef = 0;
+	}
+	
+	if(previous && hazard == previous){
+		// the hazard names one transaction at a time, so the limbo is free by now
+		assert(!limboRef);
+		// the irrevocable transaction may be looking the buffers up, so the set stays put and we take the other one
+		swap(limboAccessSet, accessSet);
+		limboArena.swap(arena);
+		limboRef = previous;
+		sharedAccessSet.store(accessSet, memory_order_release);
+	} else {
+		arena.reset();
+		accessSet->clear();
+	}
+	
+	if(!retiredSnapshots.empty())
+		releaseRetiredSnapshots();
+	
+	if(sizeHint)
+		accessSet->reserve(sizeHint);
+}
+
+bool Transaction::killReader()
+{
+	uint64_t s = state.load(memory_order_relaxed);
+	do {
+		// reader is committing, irrevocable, killed by someone else, or finished
+		if(s & (cleanReadsetLock | aborted | comitted))
+			return false;
+	} while(!state.compare_exchange_weak(s, s | cleanReadsetLock | aborted, memory_order_relaxed));
+	return true;
+}
+
+Transaction::LockOwnerState Transaction::stopLockOwner(TxRef ref)
+{
+	uint64_t s = state.load(memory_order_relaxed);
+	while(true){
+		if((s >> incarnationShift) != incarnationOf(ref))
+			// previous lock owner belongs to a forgotten past.
+			return LockOwnerState::gone;
+		
+		if(s & commitLock)
+			// either the owner already finished, or it checked all commit conditions and will just write its updates
+			return (s & (aborted | comitted)) ? LockOwnerState::gone : LockOwnerState::committing;
+		
+		// kaboom. that transaction can no longer commit.
+		if(state.compare_exchange_weak(s, s | commitLock | aborted, memory_order_relaxed))
+			return LockOwnerState::stopped;
+	}
+}
+
+bool Transaction::protect(TxRef ref)
+{
+	irrHazard.store(ref, memory_order_seq_cst);
+	
+	// the owner publishes a new incarnation before it checks the hazard, we do the opposite
+	uint64_t s = state.load(memory_order_seq_cst);
+	if((s >> incarnationShift) != incarnationOf(ref) || (s & (aborted | comitted))){
+		irrHazard.store(0, memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+void Transaction::unprotect()
+{
+	irrHazard.store(0, memory_order_release);
+}
+
+void * Transaction::protectedWriteBuffer(TxRef ref, VariableBase * var)
+{
+	// The set of ref was stored before ref took commitLock, which protect() has seen. A set stored later
+	// belongs to the next transaction and comes after the new incarnation, which we'd see below then.
+	AccessSet * set = sharedAccessSet.load(memory_order_seq_cst);
+	if((state.load(memory_order_seq_cst) >> incarnationShift) != incarnationOf(ref))
+		return nullptr;
+	
+	// ref is protected, so the descriptor leaves its set alone even if it moves on now
+	AccessEntry * e = set->find(var);
+	return e ? e->writeBuffer : nullptr;
+}
+
 // called from abort and commit
 void Transaction::cleanup()
 {
@@ -22,75 +245,174 @@ void Transaction::cleanup()
 		m->clear(memory_order_relaxed);
 	}
 	locksHeld.clear();
-	for(auto v : rsetBuffers)
-		v.first->deleteFromRset(v.second);
-	for(auto v : hijackedWsetBuffers)
-		v.first->deleteFromHijacked(v.second);
 	
-	currentTransaction.reset();
+	// we no longer need to be told about overwritten reads
+	uint64_t reads = 0, writes = 0;
+	for(auto & e : *accessSet){
+		e.var->meta().readers.remove(slot);
+		reads += e.readBuffer != nullptr;
+		writes += e.writeBuffer != nullptr;
+	}
+	ThreadStats::bump(counters.readSetEntries, reads);
+	ThreadStats::bump(counters.writeSetEntries, writes);
+	
+	// buffers are freed in bulk when the descriptor starts the next transaction
+	
+	currentTransaction = nullptr;
 }
 
 Transaction::~Transaction()
 {
-	// must stay here for hijaccking purposes
-	for(auto var : wsetBuffers){
-		var.first->deleteFromWset(var.second);
+	// descriptors live as long as the program; the arenas free whatever is left
+}
+
+Stats Transaction::statsOfAllSlots()
+{
+	Stats total;
+	for(auto & d : registry().descriptors){
+		Transaction * t = d.load(memory_order_acquire);
+		if(t)
+			t->counters.addTo(total);
+	}
+	return total;
+}
+
+void Transaction::releaseRetiredSnapshots()
+{
+	SlotRegistry & reg = registry();
+	
+	// A thread taking a reference publishes the hazard and then checks the snapshot is still current, while
+	// the snapshots were replaced before we look at the hazards; with seq_cst on both sides one of us notices.
+	vector<const SharedSnapshot*> hazards;
+	for(auto & d : reg.descriptors){
+		Transaction * t = d.load(memory_order_acquire);
+		if(!t)
+			continue;
+		const SharedSnapshot * h = t->snapshotHazard.load(memory_order_seq_cst);
+		if(h)
+			hazards.push_back(h);
 	}
+	
+	size_t kept = 0;
+	for(SharedSnapshot * s : retiredSnapshots){
+		if(find(hazards.begin(), hazards.end(), s) != hazards.end())
+			retiredSnapshots[kept++] = s;
+		else
+			s->release();
+	}
+	retiredSnapshots.resize(kept);
 }
 
 
 void Transaction::irr() {
+	if(!tryIrr())
+		throw IrrevocTransException();
+}
+
+bool Transaction::tryIrr() {
 	if(amIIrrevocable)
 		// meh.
-		return;
+		return true;
 	
-	if(irrTransactionLock.test_and_set(memory_order_relaxed)){
-		// some other transaction has the lock - it's irrevocable or trying to become irrevocable (and won the lock).
-		abort();
-		ABORT_LOG_SOURCE(1);
-		throw IrrevocTransException();
+	// irrevocable transactions take the long way everywhere
+	readOnly = false;
+	
+	if(!takeIrrToken()){
+		// we have been killed while waiting in line; our place stays for the retry
+		abort(AbortReason::irrWaitKilled);
+		return false;
 	}
 	
 	// My reads must become visible as reads of irrevocable transaction
 	if(!acquireReadset()){
-		irrTransactionLock.clear(memory_order_relaxed);
-		abort();
-		ABORT_LOG_SOURCE(3);
-		throw IrrevocTransException();
+		releaseIrrToken(memory_order_relaxed);
+		abort(AbortReason::irrReadsetLocked);
+		return false;
 	}
 	
 	// I need to make sure that nobody forces (or forced) my abort
-	if(cleanReadsetLock.test_and_set(memory_order_relaxed) || commitLock.test_and_set(memory_order_relaxed)){
-		for(auto & v : rsetBuffers)
-			v.first->usedByIrr.store(false, memory_order_release);	
-		irrTransactionLock.clear(memory_order_release);
-		abort();
-		ABORT_LOG_SOURCE(4);
-		throw IrrevocTransException();
+	if(testAndSet(cleanReadsetLock, memory_order_relaxed) || testAndSet(commitLock, memory_order_relaxed)){
+		for(auto & e : *accessSet)
+			if(e.readBuffer)
+				e.var->meta().usedByIrr.store(false, memory_order_release);
+		releaseIrrToken(memory_order_release);
+		abort(AbortReason::irrKilled);
+		return false;
 	}
 	
 	amIIrrevocable=true;
+	
+	uint64_t waitNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - irrQueuedAt).count();
+	ThreadStats::bump(counters.irrevocable);
+	ThreadStats::bump(counters.irrWaitNs, waitNs);
+	if(waitNs > counters.irrWaitMaxNs.load(memory_order_relaxed))
+		counters.irrWaitMaxNs.store(waitNs, memory_order_relaxed);
+	trace(EventKind::irrevocable, uint32_t(min<uint64_t>(waitNs / 1000, ~0u)));
+	
+	leaveIrrLine();
+	return true;
+}
+
+bool Transaction::takeIrrToken() {
+	if(!irrTicket){
+		irrQueuedAt = chrono::steady_clock::now();
+		irrTicket = irrTickets.fetch_add(1, memory_order_relaxed) + 1;
+	}
+	irrWaiting.store(irrTicket, memory_order_seq_cst);
+	
+	// Only we wait here: the irrevocable transaction stops (rather than waits for) whoever is in its way,
+	// us included, and revocable transactions never look at the line.
+	bool taken = false;
+	while(true){
+		if(irrToken.load(memory_order_seq_cst) == noIrr && firstInIrrLine()){
+			// whoever lets the token go, does so with its writes done
+			unsigned int free = noIrr;
+			if((taken = irrToken.compare_exchange_strong(free, slot, memory_order_acquire, memory_order_relaxed)))
+				break;
+		}
+		if(isAborted(memory_order_acquire))
+			break;
+		this_thread::yield();
+	}
+	
+	irrWaiting.store(0, memory_order_relaxed);
+	return taken;
+}
+
+bool Transaction::firstInIrrLine() const {
+	// Scanning all slots is fine, as irrevocability is asked for rarely. We may miss somebody who has
+	// just started waiting with a lower ticket; that's merely unfair, the token is taken by CAS anyway.
+	SlotRegistry & reg = registry();
+	for(auto & d : reg.descriptors){
+		Transaction * t = d.load(memory_order_acquire);
+		if(!t || t == this)
+			continue;
+		uint64_t other = t->irrWaiting.load(memory_order_seq_cst);
+		if(other && other < irrTicket)
+			return false;
+	}
+	return true;
 }
 
 bool Transaction::acquireReadset() {
-	list<atomic_flag*> acquired;
+	// locks of the write set are held already
+	size_t lockedBefore = locksHeld.size();
 	list<Tm::VariableBase*> setAsUsedByIrr;
 	
-	for(auto var : rsetBuffers) {
-		atomic_flag * locked = var.first->acquireRead();
-		setAsUsedByIrr.push_back(var.first);
+	for(auto & e : *accessSet) {
+		if(!e.readBuffer)
+			continue;
+		bool locked = e.var->acquireRead(this);
+		setAsUsedByIrr.push_back(e.var);
 		if(!locked){
+			e.var->blameHolder(this, VariableBase::Holder::lock);
 			for(auto v : setAsUsedByIrr)
-				v->usedByIrr.store(false);
-			for(auto m : acquired)
-				m->clear(memory_order_relaxed);
+				v->meta().usedByIrr.store(false);
+			for(size_t i = lockedBefore ; i < locksHeld.size(); ++i)
+				locksHeld[i]->clear(memory_order_relaxed);
+			locksHeld.resize(lockedBefore);
 			return false;
 		}
-		acquired.push_back(locked);
-	}
-	
-	for(auto m : acquired) {
-		locksHeld.insert(m);
 	}
 	
 	return true;
@@ -98,23 +420,33 @@ bool Transaction::acquireReadset() {
 
 
 
-void Transaction::abort()
+void Transaction::abort(AbortReason reason)
 {
-	if(comitted.load(memory_order_relaxed))
+	if(state.load(memory_order_relaxed) & comitted)
 		throw InvalidUseException();
 	
-	if(amIIrrevocable){
+	if(amIIrrevocable)
 		forcingAbortOnIrr();
-		for(auto & v : rsetBuffers)
-			v.first->usedByIrr.store(false, memory_order_release);
-		for(auto & var : wsetBuffers)
-			var.first->usedByIrr.store(false, memory_order_release);
+	
+	rollBack(reason);
+}
+
+void Transaction::rollBack(AbortReason reason)
+{
+	ThreadStats::bump(counters.abortsBy[unsigned(reason)]);
+	trace(EventKind::abort, unsigned(reason));
+	
+	// writes are buffered even when irrevocable, so there is nothing to undo but the flags
+	if(amIIrrevocable){
+		for(auto & e : *accessSet)
+			if(e.readBuffer || e.writeBuffer)
+				e.var->meta().usedByIrr.store(false, memory_order_release);
 	}
 	
-	aborted.store(true, memory_order_relaxed);
+	state.fetch_or(aborted, memory_order_relaxed);
 	
 	if(amIIrrevocable)
-		irrTransactionLock.clear();
+		releaseIrrToken(memory_order_seq_cst);
 	
 	// unlock happens in cleanup.
 	
@@ -127,28 +459,67 @@ void Transaction::killReaders(){
 	// first, let's notice all changes
 	atomic_thread_fence(memory_order_acquire);
 	
-	for(auto & var : wsetBuffers)
-		var.first->killReaders();
+	// everybody who read anything we overwrite - each of them once
+	fill(readerUnion.begin(), readerUnion.end(), 0);
+	for(auto & e : *accessSet)
+		if(e.writeBuffer)
+			e.var->meta().readers.addTo(readerUnion.data());
+	
+	// don't kill self
+	readerUnion[slot / ReaderSet::bitsPerWord] &= ~ReaderSet::bit(slot);
+	
+	uint64_t killed = 0;
+	ReaderSet::forEach(readerUnion.data(), readerUnion.size(), [this, &killed](unsigned int reader){
+		// kill everything that gives in.
+		if(descriptorOfSlot(reader)->killReader()){
+			++killed;
+			trace(EventKind::kill, reader);
+#if TM_CONFLICTS
+			// put the kill down to the first variable we write that the reader (still) reads
+			for(auto & e : *accessSet)
+				if(e.writeBuffer && e.var->meta().readers.contains(reader)){
+					blame(e.var, reader, slot, ConflictLog::kill);
+					break;
+				}
+#endif
+		}
+		// 1) those that aborted/committed -> meh (the reader unmarks itself soon).
+		// 2) irrevocable -> won't die - got their lock. Besides, we're dead aleready. Walking dead [transaction].
+		//                   simply when they read the variable, we got shot. We're going to notice that soon.
+		// 3) a next transaction of the reader's thread -> dies needlessly, but only if it raced with the unmarking.
+	});
+	if(killed)
+		ThreadStats::bump(counters.killedReaders, killed);
 }
 
 
 void Transaction::commit()
 {
-	assert( ! comitted.load(memory_order_relaxed) );
+	if(!tryCommit())
+		throw CommitFailedException();
+}
+
+bool Transaction::tryCommit()
+{
+	assert( ! (state.load(memory_order_relaxed) & comitted) );
 	
-	if(aborted.load(memory_order_relaxed)) {
+	if(!hasWrites && !amIIrrevocable)
+		return commitReadOnly();
+	
+	if(isAborted(memory_order_relaxed)) {
 		// we've been killed by a transaction that overwrote our read.
 		assert(!amIIrrevocable);
-		abort();
-		ABORT_LOG_SOURCE(5);
-		throw CommitFailedException();
+		abort(AbortReason::commitKilled);
+		return false;
 	}
 	
-	for(auto & var : wsetBuffers){
-		if(amIIrrevocable) // because of hijackedWset.find(var)!=0
-			var.first->dirtyIrr.store(true, memory_order_relaxed);
+	for(auto & e : *accessSet){
+		if(!e.writeBuffer)
+			continue;
+		if(amIIrrevocable) // because of hijackedBuffer!=0
+			e.var->meta().dirtyIrr.store(true, memory_order_relaxed);
 		else
-			var.first->dirty.store(true, memory_order_relaxed);
+			e.var->meta().dirty.store(true, memory_order_relaxed);
 		// from now on, each new reader will notice that the variable is dirty.
 		// this means that new readers are not going to spoil anything
 	}
@@ -160,21 +531,19 @@ void Transaction::commit()
 	
 	if(!amIIrrevocable){
 		// as revocable, I need to take the lock now
-		if(cleanReadsetLock.test_and_set(memory_order_release)){
-			for(auto & var : wsetBuffers){
-				var.first->dirty.store(false, memory_order_relaxed);
-			}
-			abort();
-			ABORT_LOG_SOURCE(6);
-			throw CommitFailedException();
+		if(testAndSet(cleanReadsetLock, memory_order_release)){
+			for(auto & e : *accessSet)
+				if(e.writeBuffer)
+					e.var->meta().dirty.store(false, memory_order_relaxed);
+			abort(AbortReason::commitReadsetLost);
+			return false;
 		}
-		if(commitLock.test_and_set(memory_order_release)){
-			for(auto & var : wsetBuffers){
-				var.first->dirty.store(false, memory_order_relaxed);
-			}
-			abort();
-			ABORT_LOG_SOURCE(12);
-			throw CommitFailedException();
+		if(testAndSet(commitLock, memory_order_release)){
+			for(auto & e : *accessSet)
+				if(e.writeBuffer)
+					e.var->meta().dirty.store(false, memory_order_relaxed);
+			abort(AbortReason::commitStopped);
+			return false;
 		}
 	}
 	// else {
@@ -182,26 +551,34 @@ void Transaction::commit()
 	//}
 	
 	// buffered writes are performed here & now
-	if(amIIrrevocable)
-		for(auto & var : wsetBuffers)
-			var.first->performWriteAsIrr(this, var.second);
-	else
-		for(auto & var : wsetBuffers)
-			var.first->performWrite(this, var.second);
+	if(amIIrrevocable){
+		for(auto & e : *accessSet)
+			if(e.writeBuffer)
+				e.var->performWriteAsIrr(this, e);
+	} else {
+		for(auto & e : *accessSet)
+			if(e.writeBuffer)
+				e.var->performWrite(this, e);
+	}
+	
+	// my changes need to be made visible. Only now: variables may share flags (striped metadata),
+	// so clearing them after each write would let readers in on variables yet to be written.
+	for(auto & e : *accessSet)
+		if(e.writeBuffer)
+			(amIIrrevocable ? e.var->meta().dirtyIrr : e.var->meta().dirty).store(false, memory_order_release);
 	
 	// sync vars among theads
 	atomic_thread_fence(memory_order_release);
 	
 	// after fence the vars can be free from being marked as used by irr
 	if(amIIrrevocable){
-		for(auto v : rsetBuffers)
-			v.first->usedByIrr.store(false, memory_order_relaxed);
-		for(auto var : wsetBuffers)
-			var.first->usedByIrr.store(false, memory_order_relaxed);
+		for(auto & e : *accessSet)
+			if(e.readBuffer || e.writeBuffer)
+				e.var->meta().usedByIrr.store(false, memory_order_relaxed);
 	}
 	
 	// record successful commit
-	comitted.store(true, memory_order_relaxed);
+	state.fetch_or(comitted, memory_order_relaxed);
 	
 	// sync all flags among threads
 	atomic_thread_fence(memory_order_release);
@@ -213,13 +590,34 @@ void Transaction::commit()
 	
 	// except for this lock, which has to be ordered as last
 	if(amIIrrevocable)
-		irrTransactionLock.clear(memory_order_relaxed);
+		releaseIrrToken(memory_order_relaxed);
+	
+	// having committed, we don't need irrevocability anymore
+	leaveIrrLine();
+	ThreadStats::bump(counters.commits);
+	trace(EventKind::commit, amIIrrevocable);
 	
 	cleanup();
+	return true;
 }
 
-/*namespace TM end*/}
+bool Transaction::commitReadOnly()
+{
+	// Each read checked that all reads before it were still valid, and a writer kills us before it
+	// writes anything. So if we're still alive, all reads are valid at once right now - and with
+	// nothing to write, that's all a commit has to make sure of. Writers that kill us later on
+	// find a finished transaction, which is harmless.
+	if(isAborted(memory_order_acquire)) {
+		abort(AbortReason::readOnlyCommitKilled);
+		return false;
+	}
+	
+	leaveIrrLine();
+	ThreadStats::bump(counters.commits);
+	trace(EventKind::commit, amIIrrevocable);
+	
+	cleanup();
+	return true;
+}
 
-#ifdef TRACK_ABORTS
- atomic<int> __MY_abortPlaces[255];
-#endif
\ No newline at end of file
+/*namespace TM end*/}
@@ -1,11 +1,21 @@
 #ifndef TRANSACTION_H
 #define TRANSACTION_H
 
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
 #include <memory>
 #include <functional>
 #include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+
+#include "layout.h"
+#include "accessset.h"
+#include "arena.h"
+#include "conflicts.h"
+#include "events.h"
+#include "readerset.h"
+#include "stats.h"
 
 using namespace std;
 
@@ -13,44 +23,126 @@ namespace Tm {
 
 class VariableBase;
 class Transaction;
-extern thread_local shared_ptr<Transaction> currentTransaction;
-extern thread_local unsigned int threadId;
+class SharedSnapshot;
+extern thread_local Transaction * currentTransaction;
+
+/**
+ * \brief Names one transaction: the descriptor (thread) it runs in and its incarnation in that descriptor.
+ * 
+ * Readers of variables and lock owners are remembered this way. A TxRef of a finished transaction
+ * simply stops matching the descriptor, so it never needs to be freed; 0 means "nobody".
+ */
+typedef uint64_t TxRef;
 
 /**
  * Objects of this class are stored in thread local var currentTransaction.
  * Contents of this class is mostly a list of hooks to be called on Variables.
+ * 
+ * Each thread owns one object (descriptor) that is reused by all its transactions.
+ * When the thread exits, its descriptor goes (with the thread slot) to the next thread that registers.
+ * Descriptors are never freed, so other threads can always safely look at them.
  */
 class Transaction
 {
 // My friend, class Variable, takes care of reads and writes (mostly).
 // Variables can tamper with transaction internals.
 template <typename T> friend class Variable;
+template <typename T, bool> friend class ValueStorage;
+template <typename T> friend class SnapshotStorage;
+friend class VariableBase;
 
 /* static variables - all that is related to the irrevocable transaction
  */
 
 protected:
-	/// lock guarding at-most-one irrevocable transaction
-	static atomic_flag irrTransactionLock;
+	/**
+	 * \brief Slot of the transaction that is irrevocable (or is becoming irrevocable), noIrr if there's none.
+	 * 
+	 * Guards at-most-one irrevocable transaction. Transactions that want the token line up for it (see
+	 * \sa{irrTicket}); when the token is let go, the first one waiting in line takes it.
+	 */
+	static atomic<unsigned int> irrToken;
+	static const unsigned int noIrr = ~0u;
+	
+	/// hands out places in the line for irrToken
+	static atomic<uint64_t> irrTickets;
+	
+	/**
+	 * \brief The transaction whose write set the irrevocable transaction is hijacking from right now.
+	 * 
+	 * A hazard pointer of sorts: as long as it names a transaction, its descriptor won't reuse the memory
+	 * of its write set. There is at most one irrevocable transaction, so one slot is enough.
+	 */
+	static atomic<TxRef> irrHazard;
 
 public:
-	/// creates a transaction object and "starts" / "begins" the transaction
-    Transaction();
+	/**
+	 * \brief "starts" / "begins" a transaction in the descriptor of this thread
+	 * \param sizeHint expected number of accessed variables
+	 * \param readOnly if the transaction is declared not to write (it still may, see \sa{readOnly})
+	 */
+	static Transaction * start(size_t sizeHint = 0, bool readOnly = false);
+	
+	/// \returns descriptor the transaction named by ref runs (or ran) in
+	static Transaction * descriptor(TxRef ref);
+	
+	/// \returns descriptor of the thread with given slot; nullptr if the thread never started a transaction
+	static Transaction * descriptorOfSlot(unsigned int slot);
 
 	/** \brief tries to commit
 	 *  \throws CommitFailedException */
 	void commit();
+	
+	/// tries to commit; \returns false if the transaction has been aborted instead
+	bool tryCommit();
 
 	/** \brief requests the transaction to become irrevocable
 	 *  \throws IrrevocTransException */
 	void irr(); 
+	
+	/// requests the transaction to become irrevocable; \returns false if the transaction has been aborted instead
+	bool tryIrr();
 
-	/// aborts the transaction
-	void abort();
+	/// aborts the transaction; an irrevocable one calls forcingAbortOnIrr first
+	void abort(AbortReason reason = AbortReason::explicitAbort);
+	
+	/// aborts the transaction, irrevocable or not, without asking forcingAbortOnIrr; for the library giving up on it
+	void rollBack(AbortReason reason);
+	
+	bool isIrrevocable() const {return amIIrrevocable;}
+	
+	/// \returns counters of all descriptors summed up
+	static Stats statsOfAllSlots();
+	
+#if TM_EVENTS
+	/// events of the transactions run in this descriptor, see Tm::dumpEvents()
+	const EventRing & eventRing() const {return events;}
+#endif
+	
+#if TM_CONFLICTS
+	/// conflicts recorded by this descriptor, see Tm::conflictHotspots()
+	ConflictLog & conflictLog() {return conflicts;}
+#endif
+	
+	/// \returns if an earlier transaction of this descriptor failed to become irrevocable and left it a place in line
+	bool queuedForIrr() const {return irrTicket;}
+	
+	/// gives up the place in the line for irrevocability, if any; done on each commit and on thread exit
+	void leaveIrrLine() {
+		irrTicket = 0;
+	}
 
 	/// performs final cleanup; first part is \sa{Transaction::cleanup()}
     virtual ~Transaction();
 protected:
+	/// creates a descriptor for the thread slot
+	Transaction(unsigned int slot);
+	
+	/**
+	 * \brief Takes a free thread slot for this thread and \returns its descriptor
+	 * \throws InvalidUseException if maxThreadNum threads hold a slot already
+	 */
+	static Transaction * registerThread();
 
 	/// before commit, aborts all transactions that read some var that is to be just overritten
 	void killReaders();
@@ -58,31 +150,115 @@ protected:
 	/// called while transitting to irrevocalbe state, locks all values from read set
 	bool acquireReadset();
 	
-	/// frees most of the memory held by the transaction and unlock all locks
-	void cleanup();
+	/**
+	 * \brief Queues up for irrToken unless queued already, and waits in line till the token is ours
+	 * \returns false if the transaction got aborted meanwhile; then the place in line stays
+	 */
+	bool takeIrrToken();
+	
+	/// \returns if nobody waiting in line right now has a lower ticket than ours
+	bool firstInIrrLine() const;
 	
-	/// If any trans overwrites a read of this trans, it takes this lock. Without it, this trans cannot commit.
-	atomic_flag cleanReadsetLock {ATOMIC_FLAG_INIT};
+	/// lets irrToken go to the first transaction in line
+	static void releaseIrrToken(memory_order order) {
+		irrToken.store(noIrr, order);
+	}
 	
-	/// Can only be taken by this transaction or the irrevoc. If irrevoc fails locking, it knows we successfully commit
-	atomic_flag commitLock {ATOMIC_FLAG_INIT};
+	/// tryCommit() for transactions that wrote nothing
+	bool commitReadOnly();
 	
-	/// set to true upon finishing the commit
-	atomic<bool> comitted {false};
+	/// frees most of the memory held by the transaction and unlock all locks
+	void cleanup();
 	
-	/// set to true if the transaction has or has been aborted
-	atomic<bool> aborted {false};
+	/// prepares the descriptor for a new transaction
+	void restart(size_t sizeHint, bool readOnly);
 	
-	/* Allowed states:
+	/* Bits of state. The rest of state holds the incarnation.
+	 * 
+	 * cleanReadsetLock – If any trans overwrites a read of this trans, it takes this lock. Without it, this trans cannot commit.
+	 * commitLock       – Can only be taken by this transaction or the irrevoc. If irrevoc fails locking, it knows we successfully commit
+	 * comitted         – set to true upon finishing the commit
+	 * aborted          – set to true if the transaction has or has been aborted
+	 * 
+	 * Allowed states:
 	 * comitted  aborted 
 	 *     0        0 
 	 *     0        1 
 	 *     1        0
 	 */
+	static const uint64_t cleanReadsetLock = 1, commitLock = 2, comitted = 4, aborted = 8;
+	static const unsigned incarnationShift = 4;
+	
+	/// TxRef layout: incarnation in the upper bits, thread slot in the lower slotBits
+	static const unsigned slotBits = 16;
+	
+	static uint64_t incarnationOf(TxRef ref) {return ref >> slotBits;}
+	
+	/// flags and the incarnation; others change flags only if the incarnation they know is still current
+	atomic<uint64_t> state {0};
+	
+	/// the current transaction in this descriptor
+	TxRef myRef = 0;
+	
+	/// thread slot of the descriptor
+	const unsigned int slot;
+	
+	/// sets flag of own state, \returns if it has been set before (like atomic_flag::test_and_set)
+	bool testAndSet(uint64_t flag, memory_order order) {
+		return state.fetch_or(flag, order) & flag;
+	}
+	
+	bool isAborted(memory_order order) const {
+		return state.load(order) & aborted;
+	}
+	
+	/**
+	 * \brief Called by a writer that overwrites a variable read by the transaction running in this descriptor
+	 * 
+	 * Takes cleanReadsetLock and sets aborted, unless the lock is already taken.
+	 * The reader is not named: readers are tracked per thread slot, and whichever transaction
+	 * the descriptor runs now is the one that has to go.
+	 * \returns false if the lock was taken already (the reader commits, is irrevocable or got killed before)
+	 * or the reader has finished; then nothing changes
+	 */
+	bool killReader();
+	
+	/// what the irrevocable transaction learned about a lock owner, see \sa{stopLockOwner}
+	enum class LockOwnerState {gone, stopped, committing};
+	
+	/**
+	 * \brief Called by the irrevocable transaction on the owner of a lock it needs
+	 * 
+	 * Takes commitLock and sets aborted, so that owner ref can never commit (returns stopped).
+	 * If the owner took commitLock itself and is about to write, returns committing.
+	 * If the owner ended, or the descriptor moved on to another transaction, returns gone.
+	 */
+	LockOwnerState stopLockOwner(TxRef ref);
+	
+	/**
+	 * \brief Makes sure write buffers of committing transaction ref stay around until \sa{unprotect}.
+	 * \returns false if ref has already finished; then nothing is protected
+	 */
+	bool protect(TxRef ref);
+	
+	/// ends protection started by a successful \sa{protect}
+	static void unprotect();
+	
+	/**
+	 * \brief \returns the write buffer of var in transaction ref, which the caller \sa{protect}s; nullptr if ref
+	 * does not write var, or if it has finished meanwhile
+	 */
+	void * protectedWriteBuffer(TxRef ref, VariableBase * var);
 	
 	/// Keeps track if the transaction transitted to irrevocable state
 	bool amIIrrevocable = false;
 	
+	/// declared read-only: reads skip everything related to writes; the first write or irr() clears it
+	bool readOnly = false;
+	
+	/// set on the first write; without writes, commit only checks that nobody killed the transaction
+	bool hasWrites = false;
+	
 	/**
 	 * IMPORTANT:
 	 * 
@@ -93,45 +269,143 @@ protected:
 	 * 
 	 * For writes however this gets more complicated, thus shared ptr is used; however, it is
 	 * impossible to store shared_ptr to unknown at compile type template, thus ptr to shared_ptr is used.
+	 * Small trivially copyable values do without: their write buffer is a plain word (see ValueStorage).
+	 * 
+	 * Read buffers and the shared_ptrs of write buffers live in the arena and die all at once when
+	 * the descriptor starts another transaction. Values pointed by write buffers may become the global copy,
+	 * so they are allocated from BlockPool instead.
 	 */
 	
 	/**
-	 * \brief Keeps addresses of buffers (local copies) for read variables
-	 * key is *raw* ptr of the variable class object
-	 * val is *raw* ptr of local copy
+	 * \brief Keeps addresses of buffers (local copies) for read and updated variables, as well as
+	 * buffers hijacked by an irrevocable transaction
+	 * 
+	 * Entries are never removed before the descriptor starts another transaction, as an irrevocable
+	 * transaction may look up write buffers while this transaction commits. For the same reason a set
+	 * stays where it is: the descriptor alternates between accessSets, switching pointers only.
 	 **/
-	unordered_map<VariableBase*, void*> rsetBuffers;
+	AccessSet * accessSet = &accessSets[0];
+	
+	/// memory for buffers; reset only when nobody can hijack write buffers anymore
+	Arena arena;
+	
+	/// access set and arena of an earlier transaction whose write set was protected when the descriptor moved on
+	AccessSet * limboAccessSet = &accessSets[1];
+	Arena limboArena;
+	
+	/// the earlier transaction that owns limboAccessSet and limboArena, 0 if they are free
+	TxRef limboRef = 0;
+	
+	/// what accessSet and limboAccessSet point to
+	AccessSet accessSets[2];
+	
+	/// accessSet, for \sa{protectedWriteBuffer} in the irrevocable transaction; stored whenever accessSet changes
+	atomic<AccessSet*> sharedAccessSet {&accessSets[0]};
+	
+	/// locks taken by transaction; each lock is taken at most once
+	vector<atomic_flag*> locksHeld;
 	
 	/**
-	 * \brief Holds addresses of buffers (local copies) for updated variables
-	 * key is *raw* ptr of  of the variable class object
-	 * val is ptr to shared ptr of local copy
-	 **/
-	unordered_map<VariableBase*, void*> wsetBuffers;
+	 * \brief Takes lock (of a variable to be written or locked as read) and adds it to locksHeld
+	 * \returns false if somebody else has the lock
+	 * 
+	 * With striped metadata variables share locks, so the transaction may find the lock taken by itself.
+	 */
+	bool takeLock(atomic_flag & lock, memory_order order) {
+		if(!lock.test_and_set(order)){
+			locksHeld.push_back(&lock);
+			return true;
+		}
+#if TM_METADATA == TM_METADATA_STRIPED
+		return find(locksHeld.begin(), locksHeld.end(), &lock) != locksHeld.end();
+#else
+		// each variable has own lock, and nobody locks a variable twice
+		return false;
+#endif
+	}
 	
-	/// locks taken by transaction
-	unordered_set<atomic_flag*> locksHeld;
+	/// scratch bitmap for \sa{killReaders}: slots reading any variable this transaction writes
+	vector<uint64_t> readerUnion;
 	
-	/// For irr trans keeps track of hijacked buffers 
-	unordered_map<VariableBase*, void*> hijackedWsetBuffers;
-};
-
-/*namespace TM end*/}
-
-#ifdef TRACK_ABORTS
- extern atomic<int> __MY_abortPlaces[255];
- #define ABORT_LOG_SOURCE(place) __MY_abortPlaces[place].fetch_add(1, memory_order_relaxed);
- inline void printAbortSources(){
-	for(int i = 0; i<255; ++i){
-		int aborts = __MY_abortPlaces[i].load();
-		if(aborts!=0){
-			printf ("Source: %3d    Aborts: %10d\n", i, aborts);
+	/**
+	 * \brief Place of this descriptor in the line for irrToken, 0 if it has none. Lower goes first.
+	 * 
+	 * A transaction that is aborted while waiting for the token leaves its place to the retry, so
+	 * retries don't go to the end of the line. The place is given up when the descriptor becomes
+	 * irrevocable, commits or its thread exits.
+	 */
+	uint64_t irrTicket = 0;
+	
+	/**
+	 * \brief irrTicket while a transaction of this descriptor waits for irrToken, 0 otherwise.
+	 * 
+	 * Only those actually waiting count as the line, so that a descriptor gone back to revocable work
+	 * (or to backing off) does not hold up the others; it gets its turn once it waits again.
+	 */
+	atomic<uint64_t> irrWaiting {0};
+	
+	/// when irrTicket was taken, for the irrevocable wait time in counters
+	chrono::steady_clock::time_point irrQueuedAt;
+	
+	/// snapshot (see SnapshotStorage) this thread is taking a reference to at the moment, if any
+	atomic<const SharedSnapshot*> snapshotHazard {nullptr};
+	
+	/// snapshots replaced by commits of this descriptor, that some thread might still be taking a reference to
+	vector<SharedSnapshot*> retiredSnapshots;
+	
+	/// releases retiredSnapshots that no thread is taking a reference to; the rest waits for the next transaction
+	void releaseRetiredSnapshots();
+	
+	/// statistics of the threads running in this slot, see Tm::stats()
+	ThreadStats counters;
+	
+	/// records an event of the current transaction (nothing unless built with TM_EVENTS)
+	void trace(EventKind kind, uint32_t arg = 0) {
+#if TM_EVENTS
+		events.record(kind, arg);
+#else
+		(void) kind;
+		(void) arg;
+#endif
+	}
+	
+	/// records firstRead / firstWrite on the first read / write of the current transaction
+	void traceAccess(bool write) {
+#if TM_EVENTS
+		bool & done = write ? writeTraced : readTraced;
+		if(!done){
+			done = true;
+			events.record(write ? EventKind::firstWrite : EventKind::firstRead, 0);
 		}
+#else
+		(void) write;
+#endif
 	}
- }
+	
+	/// records that the transaction of slot victim lost to that of slot culprit over var (nothing unless built with TM_CONFLICTS)
+	void blame(const VariableBase * var, unsigned int victim, unsigned int culprit, ConflictLog::Kind kind) {
+#if TM_CONFLICTS
+		conflicts.add(var, victim, culprit, kind);
 #else
- #define ABORT_LOG_SOURCE(place)
+		(void) var;
+		(void) victim;
+		(void) culprit;
+		(void) kind;
 #endif
+	}
+	
+#if TM_CONFLICTS
+	ConflictLog conflicts;
+#endif
+	
+#if TM_EVENTS
+	EventRing events;
+	/// the current transaction recorded its first read / write already
+	bool readTraced = false;
+	bool writeTraced = false;
+#endif
+};
 
+/*namespace TM end*/}
 
 #endif // TRANSACTION_H
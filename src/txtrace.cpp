@@ -0,0 +1,149 @@
+#include "txtrace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Bench {
+
+namespace {
+
+const char traceMagic[8] = {'T', 'M', 'T', 'X', 'T', 'R', 'C', '\0'};
+const uint32_t traceVersion = 1;
+
+/// \returns if [words, end) is a sequence of whole records referring to variables below vars
+bool wellFormed(const uint32_t * words, const uint32_t * end, uint32_t vars) {
+	if(words == end)
+		return false;
+	while(words != end){
+		if(size_t(end - words) < TxRecord::header)
+			return false;
+		TxRecord record(words);
+		if(uint64_t(record.transfers()) * 3 + record.reads() > uint64_t(end - words) - TxRecord::header)
+			return false;
+		for(uint32_t t = 0 ; t < record.transfers(); ++t)
+			if(record.from(t) >= vars || record.to(t) >= vars)
+				return false;
+		for(uint32_t r = 0 ; r < record.reads(); ++r)
+			if(record.read(r) >= vars)
+				return false;
+		if(record.irrAt() > (int) record.transfers() + 1)
+			return false;
+		words += record.size();
+	}
+	return true;
+}
+
+/*anonymous namespace end*/}
+
+TxTrace::~TxTrace() {
+	if(mapping)
+		munmap(mapping, mappingSize);
+}
+
+void TxTrace::create(int threads, const string & workload, uint32_t vars, uint32_t seed) {
+	info = TxTraceHeader();
+	memcpy(info.magic, traceMagic, sizeof(traceMagic));
+	info.version = traceVersion;
+	info.threads = threads;
+	info.vars = vars;
+	info.seed = seed;
+	strncpy(info.workload, workload.c_str(), sizeof(info.workload) - 1);
+	owned.assign(threads, vector<uint32_t>());
+}
+
+string TxTrace::workload() const {
+	return string(info.workload, find(info.workload, info.workload + sizeof(info.workload), '\0'));
+}
+
+const uint32_t * TxTrace::begin(int thread) const {
+	return mapping ? mapped[thread % mapped.size()].first : owned[thread % owned.size()].data();
+}
+
+const uint32_t * TxTrace::end(int thread) const {
+	if(mapping)
+		return mapped[thread % mapped.size()].second;
+	const vector<uint32_t> & s = owned[thread % owned.size()];
+	return s.data() + s.size();
+}
+
+bool TxTrace::save(const string & file) const {
+	FILE * f = fopen(file.c_str(), "wb");
+	if(!f){
+		perror(file.c_str());
+		return false;
+	}
+	bool ok = fwrite(&info, sizeof(info), 1, f) == 1;
+	for(int t = 0 ; t < threads(); ++t){
+		uint64_t words = end(t) - begin(t);
+		ok = ok && fwrite(&words, sizeof(words), 1, f) == 1;
+	}
+	for(int t = 0 ; t < threads(); ++t)
+		ok = ok && fwrite(begin(t), sizeof(uint32_t), end(t) - begin(t), f) == size_t(end(t) - begin(t));
+	ok = fclose(f) == 0 && ok;
+	if(!ok)
+		perror(file.c_str());
+	return ok;
+}
+
+bool TxTrace::load(const string & file) {
+	int fd = open(file.c_str(), O_RDONLY);
+	if(fd < 0){
+		perror(file.c_str());
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) || st.st_size < (off_t) sizeof(TxTraceHeader)){
+		fprintf(stderr, "%s: not a transaction trace\n", file.c_str());
+		close(fd);
+		return false;
+	}
+	mappingSize = st.st_size;
+	mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED){
+		mapping = nullptr;
+		perror(file.c_str());
+		return false;
+	}
+
+	const char * bytes = (const char *) mapping;
+	memcpy(&info, bytes, sizeof(info));
+	size_t offset = sizeof(info) + info.threads * sizeof(uint64_t);
+	bool ok = !memcmp(info.magic, traceMagic, sizeof(traceMagic)) && info.version == traceVersion
+	       && info.threads > 0 && info.threads < (1u << 16) && offset <= mappingSize;
+
+	mapped.clear();
+	for(uint32_t t = 0 ; ok && t < info.threads; ++t){
+		uint64_t words;
+		memcpy(&words, bytes + sizeof(info) + t * sizeof(uint64_t), sizeof(words));
+		if(words > (mappingSize - offset) / sizeof(uint32_t)){
+			ok = false;
+			break;
+		}
+		const uint32_t * first = (const uint32_t *) (bytes + offset);
+		mapped.push_back(make_pair(first, first + words));
+		offset += words * sizeof(uint32_t);
+		ok = wellFormed(first, first + words, info.vars);
+	}
+	ok = ok && offset == mappingSize;
+
+	if(!ok){
+		fprintf(stderr, "%s: not a valid transaction trace\n", file.c_str());
+		munmap(mapping, mappingSize);
+		mapping = nullptr;
+		mapped.clear();
+		return false;
+	}
+
+	// fault the records in now rather than in the timed run
+	madvise(mapping, mappingSize, MADV_WILLNEED);
+	return true;
+}
+
+/*namespace Bench end*/}
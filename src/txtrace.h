@@ -0,0 +1,128 @@
+#ifndef TXTRACE_H
+#define TXTRACE_H
+
+/**
+ * \file txtrace.h
+ * \brief Pregenerated benchmark transactions: a flat array of 32-bit words per thread, which can be saved
+ * to a file and replayed, memory-mapped, by a later run.
+ *
+ * A transaction record is
+ *
+ *     transfers, reads, irrAt, transfers × (from, to, amount), reads × variable
+ *
+ * where irrAt is 1 + the transfer before which the transaction goes irrevocable, or 0 if it stays revocable.
+ * A file holds a TxTraceHeader, the number of words of each thread's stream (uint64_t each) and the streams
+ * one after another, all in the byte order of the machine that wrote it.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Bench {
+
+/// one transaction of a trace; points into it
+class TxRecord {
+public:
+	explicit TxRecord(const uint32_t * words) : words(words) {}
+
+	uint32_t transfers() const {return words[0];}
+	uint32_t reads() const {return words[1];}
+	/// before which transfer the transaction goes irrevocable (transfers() for after the last one, beyond that never), -1 if never
+	int irrAt() const {return (int) words[2] - 1;}
+
+	uint32_t from(uint32_t transfer) const {return words[header + 3 * transfer];}
+	uint32_t to(uint32_t transfer) const {return words[header + 3 * transfer + 1];}
+	uint32_t amount(uint32_t transfer) const {return words[header + 3 * transfer + 2];}
+	uint32_t read(uint32_t i) const {return words[header + 3 * transfers() + i];}
+
+	/// in words
+	size_t size() const {return header + 3 * transfers() + reads();}
+
+	/// appends the fixed part of a record to words; transfers and reads have to follow
+	static void append(vector<uint32_t> & words, uint32_t transfers, uint32_t reads, int irrAt) {
+		words.push_back(transfers);
+		words.push_back(reads);
+		words.push_back(irrAt + 1);
+	}
+
+	static const size_t header = 3;
+
+private:
+	const uint32_t * words;
+};
+
+struct TxTraceHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t threads;
+	/// variables the records refer to
+	uint32_t vars;
+	/// seed of the run that generated the trace (it also decides the initial values)
+	uint32_t seed;
+	/// name of the workload the records are meant for
+	char workload[16];
+};
+
+class TxTrace {
+public:
+	TxTrace() {}
+	TxTrace(const TxTrace &) = delete;
+	TxTrace & operator = (const TxTrace &) = delete;
+	~TxTrace();
+
+	/// starts a trace of `threads` empty streams, to be filled through stream()
+	void create(int threads, const string & workload, uint32_t vars, uint32_t seed);
+
+	/// stream of thread, for appending records (created traces only)
+	vector<uint32_t> & stream(int thread) {return owned[thread];}
+
+	/// \returns false (and says why) if the file can't be written
+	bool save(const string & file) const;
+
+	/// maps file; \returns false (and says why) if it can't be read or is not a valid trace
+	bool load(const string & file);
+
+	int threads() const {return info.threads;}
+	uint32_t vars() const {return info.vars;}
+	uint32_t seed() const {return info.seed;}
+	string workload() const;
+
+	/// \returns the records of thread; threads beyond threads() reuse the streams from the start
+	const uint32_t * begin(int thread) const;
+	const uint32_t * end(int thread) const;
+
+private:
+	TxTraceHeader info = TxTraceHeader();
+	/// streams of a created trace
+	vector<vector<uint32_t>> owned;
+	/// [begin, end) of each stream of a loaded trace, in the mapping
+	vector<pair<const uint32_t *, const uint32_t *>> mapped;
+	void * mapping = nullptr;
+	size_t mappingSize = 0;
+};
+
+/// walks the records of one thread round and round
+class TxCursor {
+public:
+	TxCursor(const TxTrace & trace, int thread) : first(trace.begin(thread)), last(trace.end(thread)), position(first) {}
+
+	TxRecord next() {
+		TxRecord record(position);
+		position += record.size();
+		if(position == last)
+			position = first;
+		return record;
+	}
+
+private:
+	const uint32_t * first;
+	const uint32_t * last;
+	const uint32_t * position;
+};
+
+/*namespace Bench end*/}
+
+#endif // TXTRACE_H
@@ -1,6 +0,0 @@
-#include "variable.h"
-namespace Tm {
-
-// empty on purpose.
-
-/*namespace TM end*/}
\ No newline at end of file
@@ -2,13 +2,18 @@
 #define VARIABLE_H
 
 #include <cassert>
+#include <cstdlib>
 
 #include <memory>
 #include <atomic>
 #include <functional>
 #include <vector>
 
+#include "layout.h"
 #include "transaction.h"
+#include "pool.h"
+#include "orec.h"
+#include "storage.h"
 #include "tmapi.h"
 
 using namespace std;
@@ -16,7 +21,11 @@ using namespace std;
 namespace Tm {
 
 /// Parent class for all Variable\<T\> objects, which allows calling variable-related functions from Transaction class
+#if TM_METADATA == TM_METADATA_STRIPED
 class VariableBase {
+#else
+class VariableBase : protected Orec {
+#endif
 
 // Variables like transactions.
 //As variables are in public API, methods called from outside are not made public but accessed this way.
@@ -24,65 +33,109 @@ friend class Transaction;
 
 public:
 	
+#if TM_METADATA == TM_METADATA_STRIPED
+	VariableBase(){
+		initOrecs();
+	}
+#else
 	VariableBase() = default;
+#endif
 	
 	VariableBase(const VariableBase &) = delete;
 	
 	virtual ~VariableBase(){};
-
-protected:
-	
-	/// called i.a. on pre-commit to invalidate vars
-	virtual void killReaders() = 0;
-	
-	/// called on transitting to irr in order to lock a read value.
-	virtual atomic_flag * acquireRead() = 0;
-	
-	/// deleting void* is a bad idea, so this must be done here...
-	virtual void deleteFromRset(void * rawBuff) = 0;
-	
-	/// deleting void* is a bad idea, so this must be done here...
-	virtual void deleteFromWset(void * rawBuff) = 0;
-	
-	/// deleting void* is a bad idea, so this must be done here...
-	virtual void deleteFromHijacked(void * rawBuff) = 0;
-	
-	/// called on commit to make the changes of an ordinarty trans. permanent
-	virtual void performWrite(Transaction *, void * rawBuff) = 0;
 	
-	/// called on commit to make the changes of an irrevocable trans. permanent
-	virtual void performWriteAsIrr(Transaction *, void * rawBuff) = 0;
-	
-	atomic<bool> usedByIrr {false};
+#if TM_METADATA == TM_METADATA_PER_VARIABLE && TM_LAYOUT != TM_LAYOUT_DENSE
+	// C++11 new knows nothing about alignas beyond alignof(max_align_t)
+	static void * operator new(size_t size) {
+		void * ptr;
+		if(posix_memalign(&ptr, cacheLineSize, size))
+			throw bad_alloc();
+		return ptr;
+	}
 	
-	/// when var is dirty, then value and version are not consistent
-	atomic<bool> dirty {false};
+	static void * operator new[](size_t size) {
+		return operator new(size);
+	}
 	
-	/// we need another dirty for the irrevocable transaction for hijack-related reasons
-	atomic<bool> dirtyIrr {false};
+	static void operator delete(void * ptr) {
+		free(ptr);
+	}
 	
-	/// the transaction which has the lock can update global copy (i.e. var)
-	atomic_flag lock {ATOMIC_FLAG_INIT};
+	static void operator delete[](void * ptr) {
+		free(ptr);
+	}
+#endif
+
+protected:
 	
-	vector<weak_ptr<Transaction>> readers {maxThreadNum};
+	/// lock, flags and readers of the variable, possibly shared with other variables
+#if TM_METADATA == TM_METADATA_STRIPED
+	Orec & meta() {return orecOf(this);}
+#else
+	Orec & meta() {return *this;}
+#endif
 	
-	// ghr.... missing atomic ops on shared ptrs in gcc are nasty...
+	/**
+	 * \brief When transitting to irrevocable state, tries to lock the variable as read.
+	 * \returns false on failure; on success the lock is in locksHeld of ctb
+	 */
+	bool acquireRead(Transaction * ctb) {
+		Orec & orec = meta();
+		
+		// we're irr, so we don't need to add us to potential owners
+		
+		orec.usedByIrr.store(true, memory_order_relaxed);
+		
+		// If this read is not consistent, then either:
+		//  – we won't get the lock
+		//  – we have been aborted (but didn't notice it yet)
+		
+		return ctb->takeLock(orec.lock, memory_order_relaxed);
+	}
 	
-	struct WeakPtrHolder{
-		WeakPtrHolder() = default;
-		WeakPtrHolder(const WeakPtrHolder& o): ptr(o.ptr == nullptr ? nullptr : new weak_ptr<Transaction>(*o.ptr)){};
-		weak_ptr<Transaction>* ptr = nullptr;
-		virtual ~WeakPtrHolder() {delete ptr;}
+	/// what keeps a transaction from the variable, see \sa{blameHolder}
+	enum class Holder {
+		/// the irrevocable transaction if it uses the variable, the lock owner otherwise
+		lock,
+		/// the irrevocable transaction
+		irr,
+		/// whoever is committing the variable: the irrevocable transaction if dirtyIrr is set, the lock owner otherwise
+		committer
 	};
 	
-	/** When updating \sa{mostRecentLockOwner} old ptr cannot be garbage-collected, since it can be used by irr;
-	 * thus it's stored here and deleted by the next transaction */
-	WeakPtrHolder previousLockOwner;
-	// Since we store here plain ptr to weak ptr (see below), using weak_ptr or shared_ptr<weak_ptr> would
-	// make mess when anyone copies vars, as {var x = y ; begin ; w(x) ; commit ; } would free more than it should
+	/// records that ctb aborts because of holder (nothing unless built with TM_CONFLICTS, see conflicts.h)
+	void blameHolder(Transaction * ctb, Holder holder) {
+#if TM_CONFLICTS
+		Orec & orec = meta();
+		bool irr = holder == Holder::irr
+		        || (holder == Holder::lock && orec.usedByIrr.load(memory_order_relaxed))
+		        || (holder == Holder::committer && orec.dirtyIrr.load(memory_order_relaxed));
+		// the irrevocable transaction may be gone by now, and lock owners are never cleared - it's a hint
+		unsigned int culprit;
+		if(irr){
+			culprit = Transaction::irrToken.load(memory_order_relaxed);
+			if(culprit == Transaction::noIrr)
+				culprit = unknownSlot;
+		} else {
+			TxRef owner = orec.mostRecentLockOwner.load(memory_order_relaxed);
+			culprit = owner ? unsigned(owner & ((1u << Transaction::slotBits) - 1)) : unknownSlot;
+		}
+		// e.g. an earlier incarnation of ctb locked it last - whoever is in the way now can't be told
+		if(culprit == ctb->slot)
+			culprit = unknownSlot;
+		ctb->blame(this, ctb->slot, culprit, ConflictLog::abort);
+#else
+		(void) ctb;
+		(void) holder;
+#endif
+	}
+	
+	/// called on commit to make the changes of an ordinarty trans. permanent
+	virtual void performWrite(Transaction *, AccessEntry & entry) = 0;
 	
-	/// overwritten after successful lock
-	atomic<weak_ptr<Transaction>*> mostRecentLockOwner {nullptr};
+	/// called on commit to make the changes of an irrevocable trans. permanent
+	virtual void performWriteAsIrr(Transaction *, AccessEntry & entry) = 0;
 	
 };
 
@@ -91,84 +144,125 @@ protected:
  * Variable\<T\> object can be copied at will.
  * 
  * To gain read/write access one must call \sa{ro()} / \sa{rw()}.
- * Reads and writes are allowed only from within transactions. */
+ * Reads and writes are allowed only from within transactions.
+ * 
+ * ro() copies the value, unless T opts in to \sa{sharedSnapshots}; then reads share it, and only rw() copies. */
 
 template <typename T>
 class Variable : public VariableBase
 {
 protected:
-	/// the real variable
-	shared_ptr<T> varPtr;
+	typedef typename StorageOf<T>::type Storage;
+	typedef typename Storage::WriteBuffer WriteBuffer;
+	typedef typename Storage::ReadBuffer ReadBuffer;
+	
+	/// the real variable (and how buffers for it are made)
+	Storage storage;
 	
-	/// adds this variable to read set with given buffer and version
-	inline void setRset(Tm::Transaction* ctb, T* buffer){
-		ctb->rsetBuffers[this] = buffer;
+	/// adds this (not yet accessed) variable to read set with given buffer
+	inline void setRset(Tm::Transaction* ctb, ReadBuffer* buffer){
+		ctb->accessSet->insert(this).readBuffer = buffer;
+		ctb->traceAccess(false);
 	}
 	
 	/// takes this variable back from read set and returns the buffer
-	inline T* unsetRset(Tm::Transaction* ctb, const decltype(currentTransaction->rsetBuffers.find(nullptr)) & rsetElement){
-		T* ret = (T*) rsetElement->second;
-		ctb->rsetBuffers.erase(rsetElement);
+	inline ReadBuffer* unsetRset(AccessEntry * rsetElement){
+		ReadBuffer* ret = (ReadBuffer*) rsetElement->readBuffer;
+		rsetElement->readBuffer = nullptr;
 		return ret;
 	}
 	
-	/// adds this variable to write set with given buffer
-	inline void setWset(Tm::Transaction* ctb, shared_ptr<T>* buffer){
-		ctb->wsetBuffers[this]=buffer;
+	/// adds this variable to write set with given buffer; entry is nullptr if the variable has not been accessed yet
+	inline void setWset(Tm::Transaction* ctb, AccessEntry * entry, WriteBuffer* buffer){
+		if(!entry)
+			entry = &ctb->accessSet->insert(this);
+		entry->writeBuffer = buffer;
+		ctb->hasWrites = true;
+		ctb->traceAccess(true);
 	}
 	
 public:
 	
 	/// auto-constructs the variable
-	Variable() : varPtr(new T) {}
+	Variable() {}
 	
-	/// auto-constructs the variable and initializes with _val
-	Variable(T val) : Variable() {
-		*varPtr=val;
-	}
+	/// initializes the variable with _val
+	Variable(T val) : storage(val) {}
 	
 	Variable(const Variable &) = delete;
 	
-	virtual ~Variable(){
-		delete mostRecentLockOwner.load(memory_order_relaxed);
-	}
+	virtual ~Variable(){}
 	
 	/**
 	 * \brief Gives read-only access to the variable
+	 * 
+	 * The reference stays valid till the end of the transaction and reflects later writes through rw(),
+	 * except for types opting in to sharedSnapshots: their reference is to the shared, immutable snapshot.
+	 * 
 	 * \throws InvalidUseException if there is no active transaction in this thread
 	 * \throws ReadFailedException if a conflict has been detected and the transaction was aborted
 	 **/
 	const T & ro(){
+		const T * value = tryRo();
+		if(!value)
+			throw ReadFailedException();
+		return *value;
+	}
+	
+	/**
+	 * \brief Gives read-write access to the variable
+	 * \throws InvalidUseException if there is no active transaction in this thread
+	 * \throws WriteFailedException if a conflict has been detected and the transaction was aborted
+	 **/
+	T & rw(){
+		T * value = tryRw();
+		if(!value)
+			throw WriteFailedException();
+		return *value;
+	}
+	
+	/**
+	 * \brief ro() without exceptions
+	 * \returns pointer to the value as ro() would return it, or nullptr if the transaction was aborted
+	 * \throws InvalidUseException if there is no active transaction in this thread (that's a bug, not a conflict)
+	 **/
+	const T * tryRo(){
 		if(!currentTransaction){
 			nonTransAccess();
-			return *varPtr;
+			return storage.global();
 		}
 		
 		// performance hack
-		Tm::Transaction* ctb = currentTransaction.get();
+		Tm::Transaction* ctb = currentTransaction;
+		
+		if(ctb->readOnly){
+			// nothing but read buffers in here
+			AccessEntry * element = ctb->accessSet->find(this);
+			if(element)
+				return Storage::readValue((ReadBuffer*) element->readBuffer);
+			return visibleRead(ctb);
+		}
 		
 		// first, let's check the read and write set
 		{
-			const auto & elementR = ctb->rsetBuffers.find(this);
+			AccessEntry * element = ctb->accessSet->find(this);
 			
-			if (elementR != ctb->rsetBuffers.end()) {
-				// ok, the variable is in the read set.
+			if (element) {
+				if (element->readBuffer) {
+					// ok, the variable is in the read set.
+					
+					// to be precise, it's here
+					T * buffer = Storage::readValue((ReadBuffer*) element->readBuffer);
+					
+					// so let's give our buffer to the user
+					return buffer;
+				}
 				
-				// to be precise, it's here
-				T * buffer = (T*) elementR->second;
-				
-				// so let's give our buffer to the user
-				return *buffer;
-			}
-			
-			auto elementW = ctb->wsetBuffers.find(this);
-			
-			if (elementW != ctb->wsetBuffers.end()) {
-				// the var is here:
-				shared_ptr<T> * buffer = (shared_ptr<T>*) elementW->second;
+				// otherwise the var is in the write set:
+				WriteBuffer * buffer = (WriteBuffer*) element->writeBuffer;
 				
 				// so let's give it to the user
-				return **buffer;
+				return Storage::valueOf(buffer);
 			}
 		}
 		
@@ -176,234 +270,241 @@ public:
 			return roIrr(ctb);
 		}
 		
-		// Visible read - let's bookkeep the read
-		// sic: this makes a weak ptr from a shared one
-		readers[threadId] = currentTransaction;
-		
-		// make our read visible to others
-		atomic_thread_fence(memory_order_seq_cst);
-		
-		// if dirty is true, then the writer may not notice us. Also, we're deemed to abort.
-		if(dirty.load(memory_order_relaxed) || dirtyIrr.load(memory_order_relaxed)) {
-			ABORT_LOG_SOURCE(7);
-			ctb->abort();
-			throw ReadFailedException();
-		}
-		
-		// We must now make sure that we see a recent version of var
-		atomic_thread_fence(memory_order_acquire);
-		
-		// which we read right now
-		T * buffer = new T(*varPtr);
-		
-		// next we need to check if we are consistent.
-		// any transaction that could have altered the var, must have set aborted to true earlier
-		if(ctb->aborted.load(memory_order_acquire)) {
-			ABORT_LOG_SOURCE(13);
-			delete buffer;
-			ctb->abort();
-			throw ReadFailedException();
-		}
-			
-		setRset(ctb, buffer);
-		
-		return *buffer;
+		return visibleRead(ctb);
 	}
-
+	
 	/**
-	 * \brief Gives read-write access to the variable
-	 * \throws InvalidUseException if there is no active transaction in this thread
-	 * \throws WriteFailedException if a conflict has been detected and the transaction was aborted
+	 * \brief rw() without exceptions
+	 * \returns pointer to the value as rw() would return it, or nullptr if the transaction was aborted
+	 * \throws InvalidUseException if there is no active transaction in this thread (that's a bug, not a conflict)
 	 **/
-	T & rw(){
+	T * tryRw(){
 		if(!currentTransaction){
 			nonTransAccess();
-			return *varPtr;
+			return storage.global();
 		}
 		
 		// performance hack
-		Tm::Transaction* ctb = currentTransaction.get();
+		Tm::Transaction* ctb = currentTransaction;
 		
 		// first, let's check the write set
-		auto element = ctb->wsetBuffers.find(this);
+		AccessEntry * element = ctb->accessSet->find(this);
 		
-		if (element!=ctb->wsetBuffers.end()) {
+		if (element && element->writeBuffer) {
 			// the var is here:
-			shared_ptr<T> * buffer = (shared_ptr<T>*) element->second;
+			WriteBuffer * buffer = (WriteBuffer*) element->writeBuffer;
 			
 			// so let's give it to the user
-			return **buffer;
+			return Storage::valueOf(buffer);
 		}
 		
 		if(ctb->amIIrrevocable){
-			return rwIrr(ctb);
+			return rwIrr(ctb, element);
 		}
 		
 		// first access to the variable.
 		// let's go!
 		
-		if (usedByIrr.load(memory_order_acquire)){
+		// a read-only transaction becomes an ordinary one
+		ctb->readOnly = false;
+		
+		Orec & orec = meta();
+		
+		if (orec.usedByIrr.load(memory_order_acquire)){
 			// uhm... conflicting with an irrevocable cannot end well
-			ctb->abort();
-			ABORT_LOG_SOURCE(8);
-			throw WriteFailedException();
+			blameHolder(ctb, Holder::irr);
+			ctb->abort(AbortReason::writeIrr);
+			return nullptr;
 		}
 		
-		if(lock.test_and_set(memory_order_acquire)){
+		if(!ctb->takeLock(orec.lock, memory_order_acquire)){
 			// someone else has the lock, that's bad (for us)
-			ctb->abort();
-			ABORT_LOG_SOURCE(9);
-			throw WriteFailedException();
+			blameHolder(ctb, Holder::lock);
+			ctb->abort(AbortReason::writeLocked);
+			return nullptr;
 		}
 		
-		// There is a chance that a concurrent irr trans read mostRecentLockOwner and is going to use preLockOwner
-		weak_ptr<Transaction>* preLockOwner = mostRecentLockOwner.load(memory_order_acquire);
-		// But there is no chance that any trans is using this one (if that irr trans that uses ↑ would still exist, I 
-		// wouldn't be here as usedByIrr would not let me in)
-		delete previousLockOwner.ptr;
-		// So, let's dely delete of preLockOwner till anyone is here again
-		previousLockOwner.ptr = preLockOwner;
-		
-		mostRecentLockOwner.store(new weak_ptr<Transaction>(currentTransaction), memory_order_relaxed);
+		// A concurrent irr trans may still look at the previous owner - that's fine, descriptors never go away
+		orec.mostRecentLockOwner.store(ctb->myRef, memory_order_relaxed);
 		
-		if (usedByIrr.load(memory_order_acquire)){
+		if (orec.usedByIrr.load(memory_order_acquire)){
 			// this check (for the second time) is a must.
 			// without, the irrevocable transaction might not see the owner, but the owner would operate
-			lock.clear(memory_order_relaxed);
-			ctb->abort();
-			ABORT_LOG_SOURCE(10);
-			throw WriteFailedException();
+			// (the lock is released by abort)
+			blameHolder(ctb, Holder::irr);
+			ctb->abort(AbortReason::writeIrrLate);
+			return nullptr;
 		}
 		
 		// we won the lock :-)
 		
-		shared_ptr<T>* buffer = nullptr;
+		WriteBuffer* buffer = nullptr;
 		
 		// first, let's see if it has been read before
-		auto rsetElement = ctb->rsetBuffers.find(this);
-		if (rsetElement!=ctb->rsetBuffers.end()) {
+		if (element) {
 			// if we did read the var, its value is correct, as we just have validated the read set (after getting the lock)
-			// so we remove buffer from rset and re-use it for wset. 
-			buffer = new shared_ptr<T>(unsetRset(ctb, rsetElement));
+			// so we remove buffer from rset and it becomes the write buffer (see Storage::upgrade).
+			buffer = Storage::upgrade(ctb, unsetRset(element));
 		}
 		
 		if(buffer==nullptr){
 			atomic_thread_fence(memory_order_acquire);
 			// we can't just copy the pointer, we need another item
-			buffer = new shared_ptr<T>(new T(*varPtr));
+			buffer = storage.writeGlobal(ctb);
 		}
 		
 		// even though this is write, what this funcion returns is a non-const reference to val;
 		// so we must ensure that if someone reads it, it's going to be opaque.
-		if(ctb->aborted.load(memory_order_acquire)){
+		// (no buffer means that an irrevocable transaction has replaced the snapshot, after stopping us)
+		if(!buffer || ctb->isAborted(memory_order_acquire)){
 			// our state is inconsistent.
-			delete buffer;
-			lock.clear(memory_order_relaxed);
-			ctb->abort();
-			ABORT_LOG_SOURCE(11);
-			throw WriteFailedException();
+			// (buffer is freed with the arena, the lock is released by abort)
+			ctb->abort(AbortReason::writeKilled);
+			return nullptr;
 		}
 		
 		
-		setWset(ctb, buffer);
-		
-		ctb->locksHeld.insert(&lock);
+		setWset(ctb, element, buffer);
 		
-		return **buffer;
+		return Storage::valueOf(buffer);
 	}
 	
 protected:
-	/// called by ro() when the var is neither in read- nor in write-set
-	const T &  roIrr(Tm::Transaction* ctb) {
+	/// called by tryRo() when a revocable transaction reads the var for the first time
+	const T * visibleRead(Tm::Transaction* ctb) {
+		Orec & orec = meta();
+		
+		// Visible read - let's bookkeep the read (and make it visible to others)
+		orec.readers.add(ctb->slot);
+		
+		// if dirty is true, then the writer may not notice us. Also, we're deemed to abort.
+		if(orec.dirty.load(memory_order_seq_cst) || orec.dirtyIrr.load(memory_order_seq_cst)) {
+			// the var won't get to the read set, so cleanup won't unmark us
+			orec.readers.remove(ctb->slot);
+			blameHolder(ctb, Holder::committer);
+			ctb->abort(AbortReason::readDirty);
+			return nullptr;
+		}
+		
+		// We must now make sure that we see a recent version of var
+		atomic_thread_fence(memory_order_acquire);
+		
+		// which we read right now
+		ReadBuffer * buffer = storage.readGlobal(ctb);
+		
+		// next we need to check if we are consistent.
+		// any transaction that could have altered the var, must have set aborted to true earlier
+		// (and a snapshot replaced under our hands gives no buffer at all)
+		if(!buffer || ctb->isAborted(memory_order_acquire)) {
+			// (buffer is freed with the arena)
+			orec.readers.remove(ctb->slot);
+			ctb->abort(AbortReason::readKilled);
+			return nullptr;
+		}
+			
+		setRset(ctb, buffer);
+		
+		return Storage::readValue(buffer);
+	}
+	
+	/// called by tryRo() when the var is neither in read- nor in write-set
+	const T *  roIrr(Tm::Transaction* ctb) {
 		irrAcquire(ctb, true);
 		
 		// this won't loop, as irrAcquire adds var to rset/wset
-		return ro();
+		return tryRo();
 	}
 	
-	/// called by rw() when the var is not in write-set, but potentially in read-set.
-	T &  rwIrr(Tm::Transaction* ctb) {
+	/// called by tryRw() when the var is not in write-set, but potentially in read-set (then element is not null).
+	T *  rwIrr(Tm::Transaction* ctb, AccessEntry * element) {
 		
 		// first, let's see if the var is in read set
-		auto rsetElement = ctb->rsetBuffers.find(this);
-		if (rsetElement!=ctb->rsetBuffers.end()) {
+		if (element) {
 			// let's take read bufer
-			auto readBuffer = unsetRset(ctb, rsetElement);
+			auto readBuffer = unsetRset(element);
 			
-			// we can reuse it directly here
-			setWset(ctb, new shared_ptr<T>(readBuffer));
+			// it becomes the write buffer
+			setWset(ctb, element, Storage::upgrade(ctb, readBuffer));
 		} else {
 			irrAcquire(ctb, false);
 		}
 		
 		// this won't loop, as irrAcquire adds var to wset
-		return rw();
+		return tryRw();
 	}
 	
 	/// called each time when an irrevocable transaction acquires a never-seen-before variable
 	void irrAcquire(Tm::Transaction* ctb, bool wantReadOnly) {
 		
+		Orec & orec = meta();
+		
 		// tell others to hold back
-		usedByIrr.store(true, memory_order_relaxed);
+		orec.usedByIrr.store(true, memory_order_relaxed);
 		
 		do { // this is not a loop, this is syntactic sugar to replace goto's
 		
-			if(!lock.test_and_set(memory_order_relaxed)){
+			if(ctb->takeLock(orec.lock, memory_order_relaxed)){
 				// that was easy.
 				
 				// we're irr, so we don't need to add us to lock owners
 				// (as it is read only by irr, and there can be at most one irr)
-				ctb->locksHeld.insert(&lock);
 				break;
 			}
 			
 			// look up who has the lock
 			
-			weak_ptr<Transaction> * pmrlowp = mostRecentLockOwner.load(memory_order_relaxed);
+			TxRef ownerRef = orec.mostRecentLockOwner.load(memory_order_relaxed);
 			
-			if (pmrlowp == nullptr){
+			if (ownerRef == 0){
 				// if lock owner tries to progress, it will die due to usedByIrr (unless it waits or it already finished).
 				break;
 			}
 			
-			shared_ptr<Transaction> lockOwner = pmrlowp->lock();
+			Transaction * lockOwner = Transaction::descriptor(ownerRef);
 			
-			if(!lockOwner){
-				// previous lock owner belongs to a forgotten past.
+			// kaboom, unless the owner is already gone or is just writing its updates
+			Transaction::LockOwnerState ownerState = lockOwner->stopLockOwner(ownerRef);
+			if(ownerState == Transaction::LockOwnerState::stopped){
+				ctb->trace(EventKind::kill, lockOwner->slot);
+				ctb->blame(this, lockOwner->slot, ctb->slot, ConflictLog::kill);
+			}
+			if(ownerState != Transaction::LockOwnerState::committing){
 				break;
 			}
 			
-			if(!lockOwner->commitLock.test_and_set(memory_order_relaxed)){
-				// kaboom. that transaction can no longer commit.
-				// let's mark for future that it's aborted.
-				lockOwner->aborted.store(true, memory_order_relaxed);
+			// this is a live owner!
+			
+			// it has checked all commit conditions and will just write its updates.
+			// so, we must hijack its buffer - and make sure it's not freed meanwhile.
+			
+			if(!lockOwner->protect(ownerRef)){
+				// it finished in the meantime
 				break;
 			}
 			
-			// locking owner commit lock failed
-			if(lockOwner->aborted.load(memory_order_relaxed)
-				|| lockOwner->comitted.load(memory_order_relaxed) ){
-				// this possible owner already finished
-				// let's ignore it
+			WriteBuffer* hijackedBuffer = (WriteBuffer*) lockOwner->protectedWriteBuffer(ownerRef, this);
+			if(hijackedBuffer == nullptr){
+				// the owner does not write this variable, but another one sharing the lock (striped metadata),
+				// or ownerRef is so old that the incarnation counter wrapped around, or it has just finished
+				Transaction::unprotect();
 				break;
 			}
 			
-			// this is a live owner!
-			
-			// it has checked all commit conditions and will just write its updates.
-			// so, we must hijack its buffer.
-			
-			const auto & it = lockOwner->wsetBuffers.find(this);
-			assert (it != lockOwner->wsetBuffers.end());
-			shared_ptr<T>* hijackedBuffer = ((shared_ptr<T>*) it->second);
+			AccessEntry & entry = ctb->accessSet->insert(this);
 			
-			// we must keep track of the buffer, and we must properly keep track of its use count as well
-			ctb->hijackedWsetBuffers[this] = new shared_ptr<T>(*hijackedBuffer);
+			// we must keep track of the buffer, as the commit will have to write to it as well
+			entry.hijackedBuffer = Storage::hijack(ctb, hijackedBuffer, ownerRef);
+			ThreadStats::bump(ctb->counters.hijacks);
+			ctb->trace(EventKind::hijack, lockOwner->slot);
 			
 			atomic_thread_fence(memory_order_acquire);
 			
 			// we must use value that is in this buffer
-			setWset(ctb, new shared_ptr<T>(new T(**hijackedBuffer)));
+			entry.writeBuffer = Storage::newWriteBuffer(ctb, *Storage::valueOf(hijackedBuffer));
+			ctb->hasWrites = true;
+			ctb->traceAccess(true);
+			
+			Transaction::unprotect();
 			return;
 			
 		} while(false);
@@ -411,96 +512,22 @@ protected:
 		// whatever happened until now, we have exclusive access to the global var
 		
 		if(wantReadOnly){
-			setRset(ctb, new T(*varPtr));
+			setRset(ctb, storage.readGlobal(ctb));
 		} else {
-			setWset(ctb, new shared_ptr<T>(new T(*varPtr)));
-		}
-	}
-	
-	/**
-	 * \brief When transitting to irrevocable state, tries to lock the variable as read.
-	 * \returns empty ptr on failure, locked lock on success
-	 */
-    atomic_flag * acquireRead() override {
-		
-		// we're irr, so we don't need to add us to potential owners
-		
-		usedByIrr.store(true, memory_order_relaxed);
-		
-		// If this read is not consistent, then either:
-		//  – we won't get the lock
-		//  – we have been aborted (but didn't notice it yet)
-		
-		if(lock.test_and_set(memory_order_relaxed)){
-			return nullptr;
-		}
-		
-		return &lock;
-	}
-	
-	void killReaders() override {
-		for( unsigned int i = 0 ; i < maxThreadNum ; ++i ){
-			// don't kill self
-			if(i==threadId) continue;
-			
-			shared_ptr<Transaction> possReader = readers[i].lock();
-			
-			// don't kill the program
-			if(!possReader) continue;
-			
-			// kill everything that gives in.
-			if(!possReader->cleanReadsetLock.test_and_set(memory_order_relaxed)){
-				possReader->aborted.store(true, memory_order_relaxed);
-			}
-			// 1) those that aborted/committed -> meh.
-			// 2) irrevocable -> won't die - got their lock. Besides, we're dead aleready. Walking dead [transaction].
-			//                   simply when they read the variable, we got shot. We're going to notice that soon.
+			setWset(ctb, nullptr, storage.writeGlobal(ctb));
 		}
 	}
 	
-	void deleteFromRset(void * rawBuff) override {
-		// (*readers)[threadId].reset();
-		T* buffer = (T*) rawBuff;
-		delete buffer;
-	}
-	
-	void deleteFromWset(void * rawBuff) override {
-		shared_ptr<T>* buffer = (shared_ptr<T>*) rawBuff;
-		delete buffer;
-		// this delete auto-cascades.
-	}
-	
-	void deleteFromHijacked(void * rawBuff) override {
-		shared_ptr<T>* buffer = (shared_ptr<T>*) rawBuff;
-		delete buffer;
-		// this delete auto-cascades as well
-	}
-	
-	void performWriteAsIrr(Transaction * ctb, void * rawBuff) override {
-		shared_ptr<T>* newVal = (shared_ptr<T>*) rawBuff;
+	void performWriteAsIrr(Transaction * ctb, AccessEntry & entry) override {
+		storage.writeAsIrr(ctb, (WriteBuffer*) entry.writeBuffer, entry.hijackedBuffer);
 		
-		// now... if there is a hijacked transaction...
-		const auto & hijacked = ctb->hijackedWsetBuffers.find(this);
-		if(hijacked != ctb->hijackedWsetBuffers.end()){
-			shared_ptr<T>* hijackedBuffer = (shared_ptr<T>*) hijacked->second;
-			**hijackedBuffer = **newVal;
-			
-			varPtr = *hijackedBuffer;
-		} else {
-			// I have the most recent value, so acquire fence is not needed here
-			varPtr = *newVal;
-		}
-		
-		// my changes need to be made visible
-		dirtyIrr.store(false, memory_order_release);
+		// dirtyIrr is cleared by the commit once all writes are done
 	}
 	
-	void performWrite(Transaction * ctb, void * rawBuff) override {
-		shared_ptr<T>* newValShared = (shared_ptr<T>*) rawBuff;
-		
-		varPtr = *newValShared;
+	void performWrite(Transaction * ctb, AccessEntry & entry) override {
+		storage.write(ctb, (WriteBuffer*) entry.writeBuffer);
 		
-		dirty.store(false, memory_order_release);
+		// dirty is cleared by the commit once all writes are done
 	}
 };
 